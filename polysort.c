@@ -2,34 +2,382 @@
  * @file adaptive_hybrid_sort.c
  * @brief An implementation of an Adaptive Hybrid Sort algorithm in C.
  *
- * This program demonstrates a "meta" sorting algorithm that first analyzes
- * the characteristics of an input array and then selects the most appropriate
- * sorting algorithm from a pool of candidates (Quicksort, Merge Sort, Radix Sort)
- * to achieve optimal performance.
+ * This program demonstrates a "meta" sorting algorithm that first profiles
+ * an input array (size, varying key bytes, key range, runs, cardinality,
+ * presortedness), predicts the running time of every engine from that
+ * profile with a tunable cost model, and runs the cheapest engine that fits
+ * the memory budget: merge sorts, LSD and MSD radix, quicksort, counting
+ * sort, run merges or a chunked parallel sort.
+ *
+ * Build: cc -O2 -std=c11 polysort.c -o polysort -pthread -lm
  */
 
+#if defined(__linux__)
+#define _GNU_SOURCE // MAP_HUGETLB, MADV_HUGEPAGE, perf_event_open
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include <time.h>
 
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 // =============================================================================
 // 1. CONSTANTS AND STRATEGY DEFINITIONS
 // =============================================================================
 
-#define INSERTION_SORT_THRESHOLD 32
+#define INSERTION_SORT_THRESHOLD 32 // Default small-array cutoff; calibration may change it
+#define PRESORTED_CHECK_BLOCK 256 // Elements compared between early-exit checks
 #define ANALYSIS_SAMPLE_SIZE 100
-#define NEARLY_SORTED_THRESHOLD 0.85 // 85% or more elements are in ascending order
-#define LOW_CARDINALITY_THRESHOLD 0.20 // 20% or fewer unique elements
+#define PROFILE_MIN_N 256 // Smaller inputs above the cutoff are quicksorted without a profile
+#define CARDINALITY_SAMPLE_SIZE 8192 // Elements fed to the distinct-value sketch
+#define HLL_PRECISION 10 // 2^10 one-byte HyperLogLog registers (~3% error)
+#define HLL_BLOCK 256 // Keys hashed per batch before the register updates
+#define HLL_HASH_LANES 16 // Short batches are padded to a multiple of this
+#define DISTINCT_EXACT_MAX 1024 // Samples up to this size count distinct keys exactly
+#define NATURAL_MERGE_MIN_AVG_RUN 512 // Merge natural runs when they average at least this long
+#define COUNTING_SORT_LANES 4 // Interleaved histograms; repeated keys don't serialize on one counter
+#define COUNTING_SORT_MAX_RANGE (1 << 16) // Widest key range (max - min + 1) counted
+#define KWAY_MERGE_MAX_RUNS 16 // Power of two; up to this many runs are merged in one k-way pass
+#define SCRATCH_CACHE_MAX_BYTES ((size_t)256 << 20) // Larger requests bypass the thread cache
+#define SCRATCH_CACHE_IDLE_CALLS 4096 // Trim after this many calls using < 1/4 of the arena
+#define HUGE_PAGE_SIZE ((size_t)2 << 20) // 2MB transparent/explicit huge pages
+#define HUGE_PAGE_MIN_BYTES ((size_t)64 << 20) // Smaller scratch stays on normal pages
+#define HUGE_PAGE_PREFAULT_THREADS 4 // Threads that pre-fault a huge-page buffer
+#define SORT_TUNING_ENV "POLYSORT_TUNING" // Tuning file loaded before the first sort
+#define CALIBRATION_MAX_N (1 << 20) // Largest input timed by sortCalibrate
+#define CALIBRATION_MIN_SECONDS 0.02 // Each timing repeats until it covers this long
+#define CALIBRATION_MAX_CUTOFF 256 // Largest small-array cutoff calibration considers
+#define CALIBRATION_CUTOFF_SAMPLES 5 // Timings per size whose median the cutoff search uses
+#define DECISION_CACHE_SLOTS 64 // Workload tags whose analysis each thread remembers
+#define DECISION_REVALIDATE_CALLS 32 // Cached plans reused before a full re-analysis
+#define DECISION_SPOT_CHECKS 32 // Neighbouring pairs read to re-validate a cached plan
+#define DECISION_SLOWDOWN 2.0 // A cached plan this much slower than usual is dropped
+#define CHUNKED_SORT_MIN_N (1 << 20) // Smallest input the planner splits into chunks
+#define CHUNKED_SORT_CHUNK_BYTES ((size_t)1 << 20) // Largest chunk; sorted within L2
+#define CHUNKED_SORT_MIN_CHUNK 4096 // Smallest chunk when spreading a short input over threads
+#define CHUNKED_SORT_MAX_THREADS 8 // Threads sorting chunks and merging them
 
 // Enum to define the sorting strategy chosen by the analysis engine.
 typedef enum {
-    STRATEGY_MERGESORT,  // Best for nearly sorted data (Timsort stand-in)
-    STRATEGY_RADIXSORT,  // Best for non-negative integers
-    STRATEGY_QUICKSORT   // Robust default, good for low cardinality
+    STRATEGY_MERGESORT,  // Stable top-down merge; levels inside existing runs are cheap
+    STRATEGY_RADIXSORT,  // LSD radix, one pass per varying key byte (signed keys too)
+    STRATEGY_QUICKSORT,  // In-place comparison sort; re-plans badly split ranges
+    STRATEGY_MSD_RADIX,  // In-place radix when scratch memory is scarce
+    STRATEGY_BLOCK_MERGE,// Stable merge with O(1) extra memory
+    STRATEGY_INSERTION,  // Small arrays
+    STRATEGY_NATURAL_MERGE, // Many long natural runs: pairwise run merges
+    STRATEGY_KWAY_MERGE, // A few long natural runs: one k-way merge pass
+    STRATEGY_COUNTINGSORT, // Narrow key range: histogram and write-out
+    STRATEGY_CHUNKED,    // Large input: chunks sorted by their own engines in parallel, then merged
+    STRATEGY_COUNT       // Number of strategies (not a strategy)
 } SortStrategy;
 
+// Requested output order. Handled natively by every engine (no reverse pass).
+typedef enum {
+    SORT_ASCENDING,
+    SORT_DESCENDING
+} SortOrder;
+
+// Why a sort call runs the strategy it does (see sortReasonName).
+typedef enum {
+    SORT_REASON_SMALL_ARRAY,    // Below the small-array cutoff
+    SORT_REASON_ALREADY_SORTED, // One run in the requested order; nothing to do
+    SORT_REASON_REVERSED,       // One strictly reversed run; reversed in place
+    SORT_REASON_LOWEST_COST,    // Lowest predicted cost of all engines
+    SORT_REASON_MEMORY_BUDGET,  // Lowest predicted cost within max_extra_bytes
+    SORT_REASON_NO_SCRATCH,     // Scratch memory unavailable; in-place engine
+    SORT_REASON_NOT_PROFILED    // Below PROFILE_MIN_N; quicksort without a profile
+} SortReason;
+
+// Distinct-value sketch used by the analysis (internal).
+typedef struct {
+    uint8_t reg[1 << HLL_PRECISION];
+} CardinalitySketch;
+
+// Exact distinct-value count for small samples (internal): an open-addressing
+// set of the keys, probed from their sketch hashes.
+typedef struct {
+    int keys[2 * DISTINCT_EXACT_MAX];
+    bool used[2 * DISTINCT_EXACT_MAX];
+    uint32_t mask;
+    int count;
+} DistinctSet;
+
+// Presortedness of an input in the requested order (see profileData). Runs
+// are maximal stretches already in order ("ascending") or strictly reversed
+// ("descending"). The run scan stops once the runs are too short on average
+// for a run merge to pay off. Inversions come from a small strided sample,
+// cardinality, signs and key range from a larger one spread over the whole
+// array.
+typedef struct {
+    int ascending_runs;
+    int descending_runs;
+    int longest_run;         // Elements in the longest run of either kind
+    int scanned;             // Elements the run counts cover (n unless stopped early)
+    double inversion_ratio;  // Out-of-order pairs / all pairs, in the sample
+    int max_displacement;    // Farthest a sampled element is from its sorted place
+    int sampled;             // Elements in the cardinality sample (all if n is small)
+    double distinct_estimate;// Distinct values among them (exact, or HyperLogLog)
+    double unique_ratio;     // distinct_estimate / sampled
+    bool has_negative;       // Any negative value in the cardinality sample
+    int min_value;           // Smallest and largest key in the cardinality sample
+    int max_value;
+    int varying_bytes;       // Key bytes not constant across that sample
+} SortProfile;
+
+// Features the cost model predicts from (see sortCostInputsFromProfile).
+typedef struct {
+    int n;
+    size_t element_bytes;    // Bytes moved per element
+    int key_bytes;           // Varying key bytes, i.e. LSD radix passes
+    long long key_range;     // max - min + 1
+    int runs;                // Natural runs, 0 if unknown (the scan stopped early)
+    double avg_run;          // Average in-order run length (1 if mostly reversed)
+    double distinct;         // Estimated distinct keys in the whole array
+    double balance;          // 1 for random order, towards 0 for (reverse) sorted
+    int threads;             // Threads the sort may start; 1 if it must not allocate
+} SortCostInputs;
+
+// Coefficients of one engine's cost, in nanoseconds. The predicted time is
+// fixed + per_unit * n * units + per_extra * extra, where units and extra are
+// engine-specific work measures (see sortCostPredict).
+typedef struct {
+    double fixed;            // Per call
+    double per_unit;         // Per element per pass, merge level or partition level
+    double per_extra;        // Per histogram counter (counting sort) or
+                             // equal-key comparison (quicksort)
+} SortCostCoefficients;
+
+// The analysis cached for one workload tag (internal).
+typedef struct {
+    uint64_t tag;           // 0: empty slot
+    int n;
+    SortOrder order;
+    SortProfile profile;
+    double in_order_ratio;  // Of the spot-checked neighbouring pairs
+    double ns_per_element;  // Running average of the cached plan's sort time
+    unsigned uses;          // Cached calls since the last full analysis
+} SortDecision;
+
+// How a sort call would be planned, as returned by sortExplain.
+typedef struct {
+    SortStrategy strategy;   // Engine that would run
+    SortStrategy planned;    // Cheapest engine ignoring the memory budget
+    SortReason reason;
+    bool profiled;           // profile, inputs and predicted_ns are valid
+    SortProfile profile;     // Features measured on the input
+    SortCostInputs inputs;   // Cost-model inputs derived from the profile
+    double predicted_ns[STRATEGY_COUNT]; // Per engine; HUGE_VAL if it cannot run
+} SortExplanation;
+
+// True if key a must be placed strictly before key b in the given order.
+#define KEY_PRECEDES(a, b, order) ((order) == SORT_DESCENDING ? (a) > (b) : (a) < (b))
+
+// Allocator interface for scratch memory, the C counterpart of a
+// std::pmr::memory_resource. ctx is passed back to both callbacks.
+typedef struct {
+    void* (*allocate)(void* ctx, size_t bytes);
+    void (*deallocate)(void* ctx, void* ptr, size_t bytes);
+    void* ctx;
+} SortAllocator;
+
+// Caller-provided scratch memory. If buffer holds at least the bytes reported
+// by adaptiveHybridSortScratchSize, the sort performs no heap allocation.
+// Otherwise the allocator is used; with no allocator the sort falls back to an
+// in-place engine rather than touching the global heap. The buffer must be
+// aligned like malloc'd memory.
+typedef struct {
+    void* buffer;
+    size_t size;
+    const SortAllocator* allocator; // May be NULL
+} SortWorkspace;
+
+// Where a ScratchBlock's memory came from, i.e. how to give it back.
+typedef enum {
+    SCRATCH_NONE,         // Nothing to release
+    SCRATCH_BORROWED,     // The caller's workspace buffer
+    SCRATCH_ALLOCATOR,    // The workspace allocator
+    SCRATCH_THREAD_CACHE, // The calling thread's cached arena
+    SCRATCH_HEAP,         // malloc
+    SCRATCH_HUGE_PAGES    // mmap backed by 2MB pages
+} ScratchSource;
+
+// Scratch memory obtained for one sort call (internal).
+typedef struct {
+    void* ptr;
+    size_t bytes;
+    const SortAllocator* allocator; // Owner when source is SCRATCH_ALLOCATOR
+    ScratchSource source;
+} ScratchBlock;
+
+// Snapshot of the thread's scratch counters at the start of a call (internal).
+typedef struct {
+    size_t saved_peak;
+    size_t base_bytes;
+    unsigned long long bytes_total;
+    unsigned long long allocations;
+    unsigned long long threads_started;
+    long long minor_faults;
+    long long major_faults;
+} SortCallTracker;
+
+// Counters of the calling thread's scratch cache (see scratchCacheGetStats).
+typedef struct {
+    unsigned long long hits;    // Requests served by the existing arena
+    unsigned long long growths; // Times the arena was reallocated larger
+    unsigned long long trims;   // Times the arena was released by the idle policy
+    unsigned long long misses;  // Requests that bypassed the cache (too large / busy)
+    size_t capacity;            // Current arena size in bytes
+} ScratchCacheStats;
+
+// Scratch-memory footprint of one sort call.
+typedef struct {
+    size_t peak_scratch_bytes;        // High-water mark of scratch held at once
+    unsigned long long scratch_bytes; // Total scratch bytes acquired
+    unsigned long long allocations;   // Acquisitions that hit an allocator, threads started included
+    unsigned long long threads_started; // Chunked-sort workers and huge-page prefault threads
+    long long minor_faults;           // -1 unless page-fault tracking is on
+    long long major_faults;
+} SortMemoryStats;
+
+// Per-thread totals for one strategy (see sortStatsGetThread).
+typedef struct {
+    unsigned long long calls;
+    size_t peak_scratch_bytes;        // Largest peak of any single call
+    unsigned long long scratch_bytes;
+    unsigned long long allocations;
+    unsigned long long threads_started;
+    unsigned long long minor_faults;
+    unsigned long long major_faults;
+} SortStrategyStats;
+
+typedef struct {
+    SortStrategyStats by_strategy[STRATEGY_COUNT];
+    SortStrategyStats total;
+} SortThreadStats;
+
+// What a sort call actually did, filled in when SortOptions.report is set.
+typedef struct {
+    SortStrategy planned;   // Strategy preferred by the analysis
+    SortStrategy used;      // Strategy that ran
+    size_t scratch_bytes;   // Scratch memory taken by the strategy that ran
+    bool memory_downgrade;  // used != planned to respect the memory budget
+                            // or because scratch could not be obtained
+    bool analysis_cached;   // The plan came from the workload-tag cache
+    SortReason reason;      // Why `used` ran
+    SortMemoryStats memory;
+} SortReport;
+
+// Per-call options for adaptiveHybridSortWithOptions. Zero-initialize and
+// set only the fields you need.
+typedef struct {
+    SortOrder order;
+    SortWorkspace* workspace; // NULL: scratch comes from the thread cache
+    bool limit_memory;        // Enforce max_extra_bytes
+    size_t max_extra_bytes;   // Scratch bytes the sort may use when limited
+    bool use_huge_pages;      // Back large scratch buffers with 2MB pages
+    SortReport* report;       // Optional
+    uint64_t workload_tag;    // Nonzero: reuse the analysis of earlier calls with this tag
+} SortOptions;
+
+// What one sort call did and how long it took, passed to the completion
+// callback (see sortSetCompletionCallback).
+typedef struct {
+    int n;
+    SortOrder order;
+    SortStrategy planned;
+    SortStrategy used;
+    SortReason reason;
+    bool analysis_cached;
+    uint64_t workload_tag;
+    double analysis_seconds; // Presorted check, profiling and planning
+    double sort_seconds;     // Scratch acquisition and the engine
+} SortCallInfo;
+
+typedef void (*SortCompletionFn)(const SortCallInfo* info, void* context);
+
+// The calling thread's workload-tag cache counters (see sortDecisionCacheGetStats).
+typedef struct {
+    unsigned long long hits;               // Calls that reused a cached analysis
+    unsigned long long misses;             // Calls that analyzed the input in full
+    unsigned long long spot_check_failures; // Cached analyses the input no longer matched
+    unsigned long long slow_invalidations; // Cached plans dropped for running slowly
+} SortDecisionCacheStats;
+
+// A 128-bit sort key. UUIDs and hashed composite keys are loaded big-endian
+// into (hi, lo) so that unsigned ordering matches their byte order.
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} SortKey128;
+
+#define RADIX_BUCKETS 256 // Byte-wise digits for the wide-key radix engine
+#define RADIX_PREPASS_KEY_BYTES 16 // Keys this wide find constant bytes in a read pass before the histograms
+#define RADIX_WC_LINE_BYTES 64 // Write-combining staging line per radix bucket
+#define RADIX_WC_MIN_BYTES ((size_t)16 << 20) // Smaller arrays stay cache-resident; scatter directly
+#define RADIX_NONTEMPORAL_STORES 1 // 0: never stage or stream radix scatters
+#define MSD_RADIX_CUTOFF 64 // In-place MSD buckets smaller than this use Insertion Sort
+#define QUICKSORT_REPLAN_MIN 256 // Quicksort ranges this large are checked for runs and bad splits
+#define QUICKSORT_BAD_SPLIT 16 // A partition leaving under 1/16 on one side is unbalanced
+#define LOCAL_ANALYSIS_MIN 2048 // Quicksort partitions and MSD buckets this large are re-analyzed
+#define LOCAL_SAMPLE_SIZE 64 // Keys sampled to estimate a subrange's key range
+#define LOCAL_SORT_COUNTERS 4096 // Stack counters for counting sort on a subrange
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if RADIX_NONTEMPORAL_STORES && defined(__SSE2__)
+#define RADIX_WC_STREAMING 1
+#else
+#define RADIX_WC_STREAMING 0
+#endif
+#define BLOCK_MERGE_BUFFER 512 // Fixed internal merge buffer (elements, on the stack)
+#define INDIRECT_PREFETCH_DISTANCE 8 // Pointees are prefetched this many slots ahead
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch((addr), 0, 1)
+#define NOINLINE __attribute__((noinline))
+#else
+#define PREFETCH(addr) ((void)(addr))
+#define NOINLINE
+#endif
+
+// Callbacks for sorting arrays of pointers to heap objects.
+// SortCompareFn compares two pointees (qsort convention on the objects).
+// SortKeyPrefixFn returns an order-preserving 64-bit prefix of an object's
+// key: prefix(a) < prefix(b) must imply compare(a, b) < 0.
+typedef int (*SortCompareFn)(const void* a, const void* b);
+typedef uint64_t (*SortKeyPrefixFn)(const void* obj);
+
+// Column descriptions for the multi-column (ORDER BY) sort.
+typedef enum {
+    SORT_COLUMN_INT,    // values: const int64_t[]
+    SORT_COLUMN_FLOAT,  // values: const double[]
+    SORT_COLUMN_STRING  // values: const char* const[] (NUL-terminated)
+} SortColumnType;
+
+typedef struct {
+    SortColumnType type;
+    const void* values;
+    const bool* is_null; // NULL if the column has no nulls
+    bool descending;
+    bool nulls_first;
+} SortColumn;
+
 
 // =============================================================================
 // 2. FORWARD DECLARATIONS OF ALL FUNCTIONS
@@ -37,9 +385,58 @@ typedef enum {
 
 // Main adaptive sort function
 void adaptiveHybridSort(int arr[], int n);
+void adaptiveHybridSortOrdered(int arr[], int n, SortOrder order);
+bool adaptiveHybridSortWithOptions(int arr[], int n, const SortOptions* options);
+void sortSetCompletionCallback(SortCompletionFn callback, void* context);
+static void runStrategy(int arr[], int n, SortOrder order, SortStrategy strategy, void* scratch,
+                        size_t scratch_bytes);
+
+// Scratch bytes a strategy needs for n elements (0 for in-place engines)
+size_t adaptiveHybridSortScratchSize(int n, SortStrategy strategy);
+SortStrategy strategyWithinBudget(SortStrategy strategy, int n, size_t max_extra_bytes);
 
 // Analysis function
 SortStrategy analyzeData(const int arr[], int n);
+SortStrategy analyzeDataOrdered(const int arr[], int n, SortOrder order);
+void profileData(const int arr[], int n, SortOrder order, SortProfile* profile);
+static int presortedDirection(const int arr[], int n, SortOrder order);
+static inline uint32_t hashKey32(uint32_t x);
+static void sketchAdd(CardinalitySketch* sketch, const uint32_t hashes[], int count);
+static double sketchEstimate(const CardinalitySketch* sketch);
+static void distinctSetInit(DistinctSet* set, int capacity);
+static void distinctSetAdd(DistinctSet* set, const int keys[], const uint32_t hashes[], int count);
+static size_t countingSortMaxRange(int n);
+void sortCostInputsFromProfile(const SortProfile* profile, int n, SortCostInputs* inputs);
+double sortCostPredict(SortStrategy strategy, const SortCostInputs* inputs);
+SortStrategy planStrategy(const SortProfile* profile, int n, size_t max_extra_bytes);
+static SortStrategy planStrategyCosts(const SortCostInputs* inputs, size_t max_extra_bytes, double costs[]);
+static void sortDecide(const int arr[], int n, const SortOptions* options, SortExplanation* plan,
+                       SortDecision** decision, bool* reused);
+void sortExplain(const int arr[], int n, const SortOptions* options, SortExplanation* explanation);
+const char* sortReasonName(SortReason reason);
+void sortCostGetCoefficients(SortStrategy strategy, SortCostCoefficients* coefficients);
+void sortCostSetCoefficients(SortStrategy strategy, const SortCostCoefficients* coefficients);
+
+// Host tuning: calibration and the tuning file
+const char* strategyName(SortStrategy strategy);
+bool sortCalibrate(const char* path);
+bool sortTuningLoad(const char* path);
+bool sortTuningSave(const char* path);
+static void sortTuningInit(void);
+static void sortTuningLock(void);
+static void sortTuningUnlock(void);
+static int smallSortCutoff(void);
+static int sortThreads(void);
+static double sortClockNow(void);
+
+// Workload-tag cache of analyses, per thread
+static SortDecision* decisionSlot(uint64_t tag);
+static bool decisionReuse(SortDecision* decision, uint64_t tag, const int arr[], int n, SortOrder order);
+static void decisionStore(SortDecision* decision, uint64_t tag, const int arr[], int n, SortOrder order,
+                          const SortProfile* profile);
+static void decisionRecordTime(SortDecision* decision, int n, double seconds, bool reused);
+void sortDecisionCacheGetStats(SortDecisionCacheStats* stats);
+void sortDecisionCacheClear(void);
 
 // Core sorting algorithms
 void insertionSort(int arr[], int left, int right);
@@ -47,10 +444,91 @@ void quickSort(int arr[], int low, int high);
 void mergeSort(int arr[], int left, int right);
 void radixSort(int arr[], int n);
 
+// Direction-aware variants of the core algorithms
+void insertionSortOrdered(int arr[], int left, int right, SortOrder order);
+void quickSortOrdered(int arr[], int low, int high, SortOrder order);
+void mergeSortOrdered(int arr[], int left, int right, SortOrder order);
+void radixSortOrdered(int arr[], int n, SortOrder order);
+void msdRadixSort(int arr[], int n);
+void msdRadixSortOrdered(int arr[], int n, SortOrder order);
+static void reverseRange(int arr[], int lo, int hi);
+static void rotateRange(int arr[], int lo, int mid, int hi);
+static void quickSortReplan(int arr[], int low, int high, SortOrder order);
+static void quickSortWithCutoff(int arr[], int low, int high, SortOrder order, int cutoff);
+static bool subrangeSingleRun(int arr[], int n, SortOrder order);
+static bool subrangeSortLocally(int arr[], int n, SortOrder order);
+void blockMergeSort(int arr[], int n);
+void blockMergeSortOrdered(int arr[], int n, SortOrder order);
+void naturalMergeSort(int arr[], int n);
+void naturalMergeSortOrdered(int arr[], int n, SortOrder order);
+void countingSort(int arr[], int n);
+void countingSortOrdered(int arr[], int n, SortOrder order);
+bool countingSortKeyValue(int keys[], int values[], int n, SortOrder order);
+void chunkedSort(int arr[], int n);
+void chunkedSortOrdered(int arr[], int n, SortOrder order);
+static int chunkedSortChunkLength(int n, int threads);
+
+// Scratch memory management (internal)
+static bool scratchAcquire(SortWorkspace* workspace, size_t bytes, bool huge_pages, ScratchBlock* block);
+static void scratchRelease(ScratchBlock* block);
+void scratchCacheGetStats(ScratchCacheStats* stats);
+void scratchCacheTrim(void);
+
+// Scratch-memory instrumentation, aggregated per thread
+static void sortCallBegin(SortCallTracker* tracker);
+static void sortCallEnd(SortCallTracker* tracker, SortStrategy strategy, SortMemoryStats* out);
+static void sortCallFinish(SortCallTracker* tracker, SortCallInfo* info, size_t scratch_bytes,
+                           SortReport* report);
+void sortStatsGetThread(SortThreadStats* stats);
+void sortStatsResetThread(void);
+void sortStatsEnablePageFaults(bool enable);
+
+// Allocation-free variants that run on caller-provided scratch
+void mergeSortWithBuffer(int arr[], int left, int right, SortOrder order, int buf[]);
+void naturalMergeSortWithBuffer(int arr[], int n, SortOrder order, int buf[]);
+void kWayMergeSortWithBuffer(int arr[], int n, SortOrder order, int buf[]);
+void chunkedSortWithBuffer(int arr[], int n, SortOrder order, int buf[]);
+void radixSortWithBuffer(int arr[], int n, SortOrder order, int buf[]);
+bool countingSortWithBuffer(int arr[], int n, SortOrder order, uint32_t counts[], size_t capacity);
+int* radixSortInBuffers(int arr[], int n, SortOrder order, int buf[]);
+
+// Wide-key radix sorts (byte-wise LSD, constant bytes are skipped)
+void radixSortU64(uint64_t arr[], size_t n);
+void radixSortI64(int64_t arr[], size_t n);
+void radixSortKey128(SortKey128 arr[], size_t n);
+void radixSortU64Ordered(uint64_t arr[], size_t n, SortOrder order);
+void radixSortI64Ordered(int64_t arr[], size_t n, SortOrder order);
+void radixSortKey128Ordered(SortKey128 arr[], size_t n, SortOrder order);
+
+// Allocation-free wide-key radix sorts: ping-pong between arr and buf (both
+// n elements) and return whichever buffer holds the sorted output
+uint64_t* radixSortU64InBuffers(uint64_t arr[], size_t n, SortOrder order, uint64_t buf[]);
+int64_t* radixSortI64InBuffers(int64_t arr[], size_t n, SortOrder order, int64_t buf[]);
+SortKey128* radixSortKey128InBuffers(SortKey128 arr[], size_t n, SortOrder order, SortKey128 buf[]);
+#ifdef __SIZEOF_INT128__
+void radixSortU128(unsigned __int128 arr[], size_t n);
+void radixSortI128(__int128 arr[], size_t n);
+void radixSortU128Ordered(unsigned __int128 arr[], size_t n, SortOrder order);
+void radixSortI128Ordered(__int128 arr[], size_t n, SortOrder order);
+unsigned __int128* radixSortU128InBuffers(unsigned __int128 arr[], size_t n, SortOrder order,
+                                          unsigned __int128 buf[]);
+__int128* radixSortI128InBuffers(__int128 arr[], size_t n, SortOrder order, __int128 buf[]);
+#endif
+
+// Indirect sort of an array of object pointers (prefix may be NULL)
+bool indirectSort(void* ptrs[], int n, SortCompareFn compare, SortKeyPrefixFn prefix, bool stable);
+
+// Multi-column lexicographic sort; writes the sorted row order into perm
+bool multiColumnSort(const SortColumn columns[], int num_columns, int num_rows, int perm[]);
+
 // Utility functions
 void printArray(const char* label, const int arr[], int n);
 void swap(int* a, int* b);
-int compareInts(const void* a, const void* b); // For qsort in analysis
+void reverseElements(void* base, size_t n, size_t size);
+int compareInts(const void* a, const void* b);
+int compareU64(const void* a, const void* b);
+int compareI64(const void* a, const void* b);
+int compareKey128(const void* a, const void* b);
 
 
 // =============================================================================
@@ -63,39 +541,158 @@ int compareInts(const void* a, const void* b); // For qsort in analysis
  * @param n The number of elements in the array.
  */
 void adaptiveHybridSort(int arr[], int n) {
+    adaptiveHybridSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+/**
+ * @brief Sorts an array in the requested order using the best strategy.
+ * @param arr The integer array to sort.
+ * @param n The number of elements in the array.
+ * @param order SORT_ASCENDING or SORT_DESCENDING.
+ */
+void adaptiveHybridSortOrdered(int arr[], int n, SortOrder order) {
+    SortOptions options = {0};
+    options.order = order;
+    adaptiveHybridSortWithOptions(arr, n, &options);
+}
+
+/*
+ * The library itself never prints. To log or monitor decisions, register a
+ * completion callback: it runs on the sorting thread after every call that
+ * sorts two or more elements, with the plan, the reason and the time spent
+ * analyzing and sorting. The clock is only read while a callback is set (or
+ * the call has a workload tag), so an idle hook costs nothing.
+ */
+static struct {
+    SortCompletionFn callback;
+    void* context;
+} sort_completion;
+
+/**
+ * @brief Sets the function called after each sort, or NULL to remove it.
+ *        Set it before sorting threads start; the callback must be
+ *        thread-safe if several threads sort.
+ */
+void sortSetCompletionCallback(SortCompletionFn callback, void* context) {
+    sort_completion.context = context;
+    sort_completion.callback = callback;
+}
+
+/**
+ * @brief Sorts an array with explicit options (order, scratch, memory budget).
+ * @param arr The integer array to sort.
+ * @param n The number of elements in the array.
+ * @param options The options, or NULL for ascending order with cached scratch.
+ * @return true if the chosen strategy ran; false if its scratch memory was
+ *         unavailable and an in-place engine was used instead. The array is
+ *         sorted in both cases.
+ */
+bool adaptiveHybridSortWithOptions(int arr[], int n, const SortOptions* options) {
+    SortOrder order = options ? options->order : SORT_ASCENDING;
+    SortWorkspace* workspace = options ? options->workspace : NULL;
+    SortReport* report = options ? options->report : NULL;
+
     if (n <= 1) {
-        return; // Already sorted
+        return true; // Already sorted
     }
 
-    // For very small arrays, Insertion Sort is fastest.
-    if (n < INSERTION_SORT_THRESHOLD) {
-        printf(" -> Strategy: Insertion Sort (small array)\n");
-        insertionSort(arr, 0, n - 1);
-        return;
+    SortCallTracker tracker;
+    sortCallBegin(&tracker);
+    SortCallInfo info = {0};
+    info.n = n;
+    info.order = order;
+    info.workload_tag = options ? options->workload_tag : 0;
+    bool timed = info.workload_tag || sort_completion.callback;
+    double start = timed ? sortClockNow() : 0.0;
+
+    // Step 1: Analyze the data and pick the engine with the lowest predicted
+    // cost, first without and then within the memory budget (see sortDecide).
+    SortExplanation plan;
+    SortDecision* decision = NULL;
+    sortDecide(arr, n, options, &plan, &decision, &info.analysis_cached);
+    SortStrategy strategy = plan.strategy;
+    info.planned = plan.planned;
+    info.reason = plan.reason;
+    double planned_at = timed ? sortClockNow() : 0.0;
+    info.analysis_seconds = planned_at - start;
+
+    // An array that is one run, in order or strictly reversed, needs no
+    // engine: it is left as is or reversed in place (which keeps it stable).
+    if (plan.reason == SORT_REASON_ALREADY_SORTED || plan.reason == SORT_REASON_REVERSED) {
+        if (plan.reason == SORT_REASON_REVERSED) reverseRange(arr, 0, n);
+        info.used = strategy;
+        info.sort_seconds = timed ? sortClockNow() - planned_at : 0.0;
+        sortCallFinish(&tracker, &info, 0, report);
+        return true;
+    }
+
+    // Step 2: Obtain the scratch memory.
+    ScratchBlock scratch;
+    bool huge_pages = options && options->use_huge_pages;
+    bool have_scratch = scratchAcquire(workspace, adaptiveHybridSortScratchSize(n, strategy), huge_pages, &scratch);
+    if (!have_scratch) {
+        strategy = strategyWithinBudget(strategy, n, 0); // In-place engine
+        info.reason = SORT_REASON_NO_SCRATCH;
     }
+    size_t scratch_bytes = scratch.bytes;
+
+    // Step 3: Execute the chosen sorting algorithm.
+    runStrategy(arr, n, order, strategy, scratch.ptr, scratch_bytes);
 
-    // Step 1: Analyze the data to determine the best strategy.
-    SortStrategy strategy = analyzeData(arr, n);
+    scratchRelease(&scratch);
+
+    info.used = strategy;
+    info.sort_seconds = timed ? sortClockNow() - planned_at : 0.0;
+    if (decision) decisionRecordTime(decision, n, info.sort_seconds, info.analysis_cached);
+    sortCallFinish(&tracker, &info, have_scratch ? scratch_bytes : 0, report);
+    return have_scratch;
+}
 
-    // Step 2: Execute the chosen sorting algorithm.
+/*
+ * Runs one engine on scratch of scratch_bytes, which must be at least
+ * adaptiveHybridSortScratchSize(n, strategy). Shared by the dispatcher and
+ * the chunked sort, which runs it on every chunk.
+ */
+static void runStrategy(int arr[], int n, SortOrder order, SortStrategy strategy, void* scratch,
+                        size_t scratch_bytes) {
     switch (strategy) {
+        case STRATEGY_INSERTION:
+            insertionSortOrdered(arr, 0, n - 1, order);
+            break;
         case STRATEGY_MERGESORT:
-            printf(" -> Strategy: Merge Sort (for nearly sorted data)\n");
-            mergeSort(arr, 0, n - 1);
+            mergeSortWithBuffer(arr, 0, n - 1, order, (int*)scratch);
             break;
         case STRATEGY_RADIXSORT:
-            printf(" -> Strategy: Radix Sort (for non-negative integers)\n");
-            radixSort(arr, n);
+            radixSortWithBuffer(arr, n, order, (int*)scratch);
+            break;
+        case STRATEGY_MSD_RADIX:
+            msdRadixSortOrdered(arr, n, order);
+            break;
+        case STRATEGY_BLOCK_MERGE:
+            blockMergeSortOrdered(arr, n, order);
+            break;
+        case STRATEGY_NATURAL_MERGE:
+            naturalMergeSortWithBuffer(arr, n, order, (int*)scratch);
+            break;
+        case STRATEGY_KWAY_MERGE:
+            kWayMergeSortWithBuffer(arr, n, order, (int*)scratch);
+            break;
+        case STRATEGY_COUNTINGSORT:
+            if (!countingSortWithBuffer(arr, n, order, (uint32_t*)scratch,
+                                        scratch_bytes / sizeof(uint32_t))) {
+                msdRadixSortOrdered(arr, n, order); // Sample missed an outlier
+            }
+            break;
+        case STRATEGY_CHUNKED:
+            chunkedSortWithBuffer(arr, n, order, (int*)scratch);
             break;
         case STRATEGY_QUICKSORT:
         default:
-            printf(" -> Strategy: Quicksort (robust default)\n");
-            quickSort(arr, 0, n - 1);
+            quickSortOrdered(arr, 0, n - 1, order);
             break;
     }
 }
 
-
 // =============================================================================
 // 4. HEURISTIC ANALYSIS ENGINE
 // =============================================================================
@@ -107,235 +704,3336 @@ void adaptiveHybridSort(int arr[], int n) {
  * @return The recommended SortStrategy.
  */
 SortStrategy analyzeData(const int arr[], int n) {
-    int sample_size = (n < ANALYSIS_SAMPLE_SIZE) ? n : ANALYSIS_SAMPLE_SIZE;
-    bool has_negative = false;
+    return analyzeDataOrdered(arr, n, SORT_ASCENDING);
+}
 
-    // --- Heuristic 1: Check for nearly sorted data & negative numbers ---
-    int ascending_pairs = 0;
-    for (int i = 0; i < sample_size - 1; ++i) {
-        if (arr[i] < 0) has_negative = true;
-        if (arr[i] <= arr[i + 1]) {
-            ascending_pairs++;
-        }
+/**
+ * @brief Like analyzeData, but measures sortedness in the requested order.
+ */
+SortStrategy analyzeDataOrdered(const int arr[], int n, SortOrder order) {
+    sortTuningInit();
+    if (n < smallSortCutoff()) return STRATEGY_INSERTION;
+    if (n < PROFILE_MIN_N) return STRATEGY_QUICKSORT;
+    SortProfile profile;
+    profileData(arr, n, order, &profile);
+    return planStrategy(&profile, n, SIZE_MAX);
+}
+
+// Counts the pairs a[j] > a[j + 1] and a[j] < a[j + 1] for j < m, four at a
+// time with SSE2 compares.
+static void countNeighbourOrder(const int a[], int m, int* falls_out, int* rises_out) {
+    int falls = 0, rises = 0, j = 0;
+#if defined(__SSE2__)
+    __m128i fall_acc = _mm_setzero_si128(), rise_acc = _mm_setzero_si128();
+    for (; j + 4 <= m; j += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + j));
+        __m128i y = _mm_loadu_si128((const __m128i*)(a + j + 1));
+        fall_acc = _mm_sub_epi32(fall_acc, _mm_cmpgt_epi32(x, y)); // True lanes are -1
+        rise_acc = _mm_sub_epi32(rise_acc, _mm_cmpgt_epi32(y, x));
+    }
+    int lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, fall_acc);
+    falls = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm_storeu_si128((__m128i*)lanes, rise_acc);
+    rises = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; j < m; j++) {
+        falls += a[j] > a[j + 1];
+        rises += a[j] < a[j + 1];
     }
-    if ((double)ascending_pairs / (sample_size - 1) >= NEARLY_SORTED_THRESHOLD) {
-        return STRATEGY_MERGESORT; // Merge sort is efficient for nearly sorted data.
+    *falls_out = falls;
+    *rises_out = rises;
+}
+
+/**
+ * @brief Checks the whole array for a single run in O(n).
+ *
+ * Neighbours are compared a block of PRESORTED_CHECK_BLOCK pairs at a time
+ * with branch-free vector counts, and the scan stops after the first block
+ * that rules out both outcomes, so unsorted input usually costs one block.
+ * @return 1 if arr is already in the requested order, -1 if it is strictly
+ *         in the opposite order (reversing it keeps the sort stable), else 0.
+ */
+static int presortedDirection(const int arr[], int n, SortOrder order) {
+    bool in_order = true, reversed = true;
+    for (int i = 0; i + 1 < n; i += PRESORTED_CHECK_BLOCK) {
+        int m = (n - 1 - i < PRESORTED_CHECK_BLOCK) ? n - 1 - i : PRESORTED_CHECK_BLOCK;
+        int falls, rises;
+        countNeighbourOrder(arr + i, m, &falls, &rises);
+        // Ascending: in order with no falls, reversed if every pair falls.
+        int against = (order == SORT_DESCENDING) ? rises : falls;
+        int along = (order == SORT_DESCENDING) ? falls : rises;
+        in_order = in_order && against == 0;
+        reversed = reversed && along == 0 && against == m;
+        if (!in_order && !reversed) return 0;
     }
+    return in_order ? 1 : -1;
+}
 
-    // --- Heuristic 2: If no negatives, Radix Sort is a strong candidate ---
-    if (!has_negative) {
-        return STRATEGY_RADIXSORT;
+// Stably sorts the positions 0..s-1 of sample by key in the requested order
+// (bottom-up merges) into rank_order and returns the number of inverted
+// pairs: each key taken from the right half jumps every key left in the left.
+static long long sampleRankOrder(const int sample[], int s, SortOrder order, int rank_order[]) {
+    int merged[ANALYSIS_SAMPLE_SIZE];
+    long long inversions = 0;
+    for (int i = 0; i < s; i++) rank_order[i] = i;
+    for (int width = 1; width < s; width *= 2) {
+        for (int lo = 0; lo + width < s; lo += 2 * width) {
+            int mid = lo + width, hi = (s - mid < width) ? s : mid + width;
+            int i = lo, j = mid, k = 0;
+            while (i < mid && j < hi) {
+                if (KEY_PRECEDES(sample[rank_order[j]], sample[rank_order[i]], order)) {
+                    inversions += mid - i;
+                    merged[k++] = rank_order[j++];
+                } else {
+                    merged[k++] = rank_order[i++];
+                }
+            }
+            while (i < mid) merged[k++] = rank_order[i++];
+            memcpy(rank_order + lo, merged, k * sizeof(int)); // The rest of the right half is in place
+        }
     }
+    return inversions;
+}
+
+/**
+ * @brief Measures how presorted an array is in the requested order.
+ *
+ * One sequential pass counts the natural runs, reversed runs and the longest
+ * run; it stops as soon as there are more runs than a run merge can use
+ * (over KWAY_MERGE_MAX_RUNS and an average length below
+ * NATURAL_MERGE_MIN_AVG_RUN), so random input only pays for a short prefix.
+ * Inversions and displacement are counted while merge-sorting
+ * ANALYSIS_SAMPLE_SIZE elements taken at an even stride; distinct values,
+ * signs, key range and varying key bytes are measured on up to
+ * CARDINALITY_SAMPLE_SIZE elements (the whole array when it is smaller).
+ * @param arr The array to analyze.
+ * @param n The size of the array.
+ * @param order The order the array will be sorted in.
+ * @param profile Receives the measurements.
+ */
+void profileData(const int arr[], int n, SortOrder order, SortProfile* profile) {
+    memset(profile, 0, sizeof(*profile));
+    if (n <= 0) return;
 
-    // --- Heuristic 3: Check for low cardinality (many duplicates) ---
-    // To do this, we sort a copy of the sample and count unique elements.
-    int* sample_copy = (int*)malloc(sample_size * sizeof(int));
-    if (!sample_copy) return STRATEGY_QUICKSORT; // Failsafe
-    
-    memcpy(sample_copy, arr, sample_size * sizeof(int));
-    qsort(sample_copy, sample_size, sizeof(int), compareInts);
+    // --- Natural runs ---
+    long long max_runs = n / NATURAL_MERGE_MIN_AVG_RUN;
+    if (max_runs < KWAY_MERGE_MAX_RUNS) max_runs = KWAY_MERGE_MAX_RUNS;
+    int lo = 0;
+    while (lo < n) {
+        int hi = lo + 1;
+        if (hi < n && KEY_PRECEDES(arr[hi], arr[lo], order)) {
+            while (hi < n && KEY_PRECEDES(arr[hi], arr[hi - 1], order)) hi++;
+            profile->descending_runs++;
+        } else {
+            while (hi < n && !KEY_PRECEDES(arr[hi], arr[hi - 1], order)) hi++;
+            profile->ascending_runs++;
+        }
+        if (hi - lo > profile->longest_run) profile->longest_run = hi - lo;
+        lo = hi;
+        if (profile->ascending_runs + profile->descending_runs > max_runs && lo < n) break;
+    }
+    profile->scanned = lo;
 
-    int unique_count = 1;
-    for (int i = 1; i < sample_size; ++i) {
-        if (sample_copy[i] != sample_copy[i - 1]) {
-            unique_count++;
+    // --- Cardinality, signs, range: large strided sample ---
+    // Small samples count their distinct keys exactly, larger ones go
+    // through the sketch.
+    int cs = (n < CARDINALITY_SAMPLE_SIZE) ? n : CARDINALITY_SAMPLE_SIZE;
+    size_t stride = (size_t)n / cs;
+    bool exact = cs <= DISTINCT_EXACT_MAX;
+    CardinalitySketch sketch;
+    DistinctSet distinct;
+    distinctSetInit(&distinct, exact ? cs : 0); // Stays empty when the sketch counts
+    if (!exact) memset(&sketch, 0, sizeof(sketch));
+    int keys[HLL_BLOCK];
+    uint32_t hashes[HLL_BLOCK];
+    int negatives = 0, lo_key = arr[0], hi_key = arr[0];
+    uint32_t diff = 0;
+    for (int i = 0; i < cs; i += HLL_BLOCK) {
+        // Gather the strided keys into a block, padding a short last block
+        // with repeats (which change none of the results) to a multiple of
+        // HLL_HASH_LANES, so the hash loop below runs over contiguous keys
+        // with a constant inner trip count and is vectorized at -O2.
+        int m = (cs - i < HLL_BLOCK) ? cs - i : HLL_BLOCK;
+        int padded = (m + HLL_HASH_LANES - 1) / HLL_HASH_LANES * HLL_HASH_LANES;
+        const int* src = arr + (size_t)i * stride;
+        for (int j = 0; j < m; j++) keys[j] = src[(size_t)j * stride];
+        for (int j = m; j < padded; j++) keys[j] = keys[0];
+        for (int b = 0; b < padded; b += HLL_HASH_LANES) {
+            for (int j = b; j < b + HLL_HASH_LANES; j++) {
+                int x = keys[j];
+                negatives |= x < 0;
+                lo_key = x < lo_key ? x : lo_key;
+                hi_key = x > hi_key ? x : hi_key;
+                diff |= (uint32_t)x ^ (uint32_t)arr[0];
+                hashes[j] = hashKey32((uint32_t)x);
+            }
         }
+        if (exact) distinctSetAdd(&distinct, keys, hashes, m);
+        else sketchAdd(&sketch, hashes, m);
     }
-    free(sample_copy);
+    profile->has_negative = negatives > 0;
+    profile->min_value = lo_key;
+    profile->max_value = hi_key;
+    for (; diff; diff >>= 8) profile->varying_bytes += (diff & 0xFF) != 0;
+    profile->sampled = cs;
+    profile->distinct_estimate = exact ? distinct.count : sketchEstimate(&sketch);
+    if (profile->distinct_estimate > cs) profile->distinct_estimate = cs;
+    profile->unique_ratio = profile->distinct_estimate / cs;
 
-    if ((double)unique_count / sample_size <= LOW_CARDINALITY_THRESHOLD) {
-        return STRATEGY_QUICKSORT; // 3-Way Quicksort would be ideal, but standard is also good.
+    // --- Order: small strided sample ---
+    int s = (n < ANALYSIS_SAMPLE_SIZE) ? n : ANALYSIS_SAMPLE_SIZE;
+    int sample[ANALYSIS_SAMPLE_SIZE];
+    for (int i = 0; i < s; i++) {
+        sample[i] = arr[(long long)i * n / s];
     }
 
-    // --- Default Case ---
-    return STRATEGY_QUICKSORT;
+    // Inversions and each sample's stable rank in the requested order.
+    int rank_order[ANALYSIS_SAMPLE_SIZE];
+    long long inversions = sampleRankOrder(sample, s, order, rank_order);
+    int max_shift = 0;
+    for (int rank = 0; rank < s; rank++) {
+        int shift = rank > rank_order[rank] ? rank - rank_order[rank] : rank_order[rank] - rank;
+        if (shift > max_shift) max_shift = shift;
+    }
+    long long pairs = (long long)s * (s - 1) / 2;
+    profile->inversion_ratio = pairs ? (double)inversions / pairs : 0.0;
+    profile->max_displacement = (int)((long long)max_shift * n / s);
 }
 
+// --- Cost Model ---
+/*
+ * Instead of a fixed cascade of thresholds, every engine's running time is
+ * predicted from the profile and the cheapest engine that fits the memory
+ * budget is chosen. Each prediction is a work measure specific to the engine
+ * (passes for the radix and counting sorts, merge levels, partition levels)
+ * scaled by coefficients from sort_cost_table, which can be tuned per machine
+ * with sortCostSetCoefficients. The defaults were fitted on x86-64 with 4-byte
+ * keys, from 1M to 16M elements.
+ */
+static SortCostCoefficients sort_cost_table[STRATEGY_COUNT] = {
+    //                          fixed   per_unit  per_extra
+    [STRATEGY_MERGESORT]     = {100.0,  9.0,      0.0},
+    [STRATEGY_RADIXSORT]     = {1000.0, 7.0,      0.0},
+    [STRATEGY_QUICKSORT]     = {0.0,    6.3,      1.0},
+    [STRATEGY_MSD_RADIX]     = {100.0,  6.0,      0.0},
+    [STRATEGY_BLOCK_MERGE]   = {100.0,  2.0,      0.0},
+    [STRATEGY_INSERTION]     = {0.0,    1.0,      0.0},
+    [STRATEGY_NATURAL_MERGE] = {100.0,  3.8,      0.0},
+    [STRATEGY_KWAY_MERGE]    = {100.0,  3.0,      0.0},
+    [STRATEGY_COUNTINGSORT]  = {200.0,  0.45,     0.5},
+    [STRATEGY_CHUNKED]       = {20000.0, 4.0,     1.0},
+};
 
-// =============================================================================
-// 5. IMPLEMENTATIONS OF CORE SORTING ALGORITHMS
-// =============================================================================
+/**
+ * @brief Derives the cost model's features from a profile of n int keys.
+ */
+void sortCostInputsFromProfile(const SortProfile* profile, int n, SortCostInputs* inputs) {
+    inputs->n = n;
+    inputs->element_bytes = sizeof(int);
+    inputs->key_bytes = profile->varying_bytes;
+    inputs->key_range = (long long)profile->max_value - profile->min_value + 1;
+    int runs = profile->ascending_runs + profile->descending_runs;
+    inputs->runs = profile->scanned == n ? runs : 0;
+    bool reversed = profile->descending_runs > profile->ascending_runs;
+    inputs->avg_run = (runs && !reversed) ? (double)profile->scanned / runs : 1.0;
+    // A sample with many repeats has seen most of the keys; otherwise the
+    // distinct fraction carries over to the whole array.
+    inputs->distinct = profile->unique_ratio < 0.5 ? profile->distinct_estimate
+                                                   : profile->unique_ratio * n;
+    if (inputs->distinct < 1.0) inputs->distinct = 1.0;
+    double inv = profile->inversion_ratio;
+    inputs->balance = 2.0 * (inv < 1.0 - inv ? inv : 1.0 - inv);
+    inputs->threads = sortThreads();
+}
 
-// --- Insertion Sort ---
-void insertionSort(int arr[], int left, int right) {
-    for (int i = left + 1; i <= right; i++) {
-        int key = arr[i];
-        int j = i - 1;
-        while (j >= left && arr[j] > key) {
-            arr[j + 1] = arr[j];
-            j = j - 1;
+// Work measures of one engine: its time is modelled as fixed + per_unit *
+// width * n * units + per_extra * extra. False if it cannot run on the input.
+static bool sortCostUnits(SortStrategy strategy, const SortCostInputs* in, double* units_out, double* extra_out) {
+    if (strategy < 0 || strategy >= STRATEGY_COUNT || in->n <= 1) return false;
+    double n = in->n;
+    double levels = log2(n);
+    double units, extra = 0.0;
+    switch (strategy) {
+        case STRATEGY_MERGESORT: { // Top-down, every level merges
+            // Levels inside existing runs merge predictably and cost a fraction.
+            double presorted = fmin(log2(fmax(in->avg_run, 1.0)), levels);
+            units = (levels - presorted) + 0.1 * presorted;
+            break;
+        }
+        case STRATEGY_BLOCK_MERGE: { // Insertion-sorted blocks, then merges; merges
+            // above the fixed buffer rotate, giving O(n log^2 n). Merges of
+            // runs already in order are skipped.
+            double base = log2(smallSortCutoff());
+            double presorted = fmin(log2(fmax(in->avg_run, 1.0)), levels);
+            double merge_levels = fmax(levels - fmax(base, presorted), 0.0);
+            units = 1.0 + smallSortCutoff() / 2.0 * fmax(1.0 - presorted / base, 0.0) +
+                    merge_levels * (1.0 + fmax(0.0, levels - log2(BLOCK_MERGE_BUFFER)) / 2.0);
+            break;
+        }
+        case STRATEGY_RADIXSORT: // Histogram pass, one scatter per varying byte, odd copy-back
+            units = 1.0 + in->key_bytes + (in->key_bytes % 2);
+            break;
+        case STRATEGY_MSD_RADIX: { // Count + permute per level until buckets are small
+            double depth = ceil(log(fmax(n / MSD_RADIX_CUTOFF, 1.0)) / log(RADIX_BUCKETS)) + 1.0;
+            units = 1.0 + 2.0 * fmin(depth, (double)sizeof(int));
+            break;
+        }
+        case STRATEGY_QUICKSORT: { // Lomuto, last-element pivot
+            // Presorted input unbalances the partitions, down to n/2 levels;
+            // each group of equal keys degrades to quadratic.
+            double depth = fmin(levels / fmax(in->balance, 1.0 / 64.0), n / 2.0);
+            units = depth;
+            extra = n * n / (2.0 * in->distinct);
+            break;
+        }
+        case STRATEGY_NATURAL_MERGE:
+            if (in->runs == 0) return false;
+            units = 0.25 + ceil(log2(in->runs)); // Run scans are cheap next to merges
+            break;
+        case STRATEGY_KWAY_MERGE:
+            if (in->runs == 0 || in->runs > KWAY_MERGE_MAX_RUNS) return false;
+            units = 2.0 + log2(in->runs);
+            break;
+        case STRATEGY_COUNTINGSORT: // Min/max, histogram, write-out
+            if (in->key_range > (long long)countingSortMaxRange(in->n)) return false;
+            units = 3.0;
+            extra = (double)in->key_range * COUNTING_SORT_LANES;
+            break;
+        case STRATEGY_CHUNKED: { // Chunks sorted in parallel, then pairwise merge passes
+            int threads = in->threads;
+            if (in->n < CHUNKED_SORT_MIN_N || threads < 2) return false;
+            // Each chunk is planned like an input of its own: the runs split
+            // between the chunks, the other features carry over.
+            SortCostInputs chunk = *in;
+            chunk.n = chunkedSortChunkLength(in->n, threads);
+            double chunks = ceil(n / chunk.n);
+            if (in->runs) chunk.runs = (int)fmax(in->runs / chunks, 1.0);
+            chunk.distinct = fmin(in->distinct, chunk.n);
+            double chunk_costs[STRATEGY_COUNT];
+            SortStrategy best = planStrategyCosts(&chunk, (size_t)chunk.n * sizeof(int), chunk_costs);
+            units = ceil(log2(chunks)) / threads;
+            extra = chunk_costs[best] * ceil(chunks / threads);
+            break;
         }
-        arr[j + 1] = key;
+        case STRATEGY_INSERTION:
+        default: // n^2 / 4 moves on random input
+            units = n / 4.0;
+            break;
     }
+    *units_out = units;
+    *extra_out = extra;
+    return true;
 }
 
-// --- Quicksort ---
-int partition(int arr[], int low, int high) {
-    int pivot = arr[high];
-    int i = (low - 1);
-    for (int j = low; j <= high - 1; j++) {
-        if (arr[j] < pivot) {
-            i++;
-            swap(&arr[i], &arr[j]);
+/**
+ * @brief Predicts the time, in nanoseconds, for one engine to sort the input.
+ * @return HUGE_VAL if the engine cannot run on this input.
+ */
+double sortCostPredict(SortStrategy strategy, const SortCostInputs* in) {
+    double units, extra;
+    if (!sortCostUnits(strategy, in, &units, &extra)) return HUGE_VAL;
+    // The sampled inversions are too coarse to bound insertion sort's
+    // quadratic worst case; it only runs below the small-array cutoff.
+    if (strategy == STRATEGY_INSERTION && in->n >= smallSortCutoff()) return HUGE_VAL;
+    const SortCostCoefficients* c = &sort_cost_table[strategy];
+    double width = (double)in->element_bytes / sizeof(int);
+    return c->fixed + c->per_unit * width * in->n * units + c->per_extra * extra;
+}
+
+/**
+ * @brief Chooses the engine with the lowest predicted cost.
+ * @param profile The input's profile (see profileData).
+ * @param n The number of elements.
+ * @param max_extra_bytes Scratch memory the engine may use (SIZE_MAX: any).
+ * @return The cheapest engine whose scratch fits, Quicksort if none does.
+ */
+SortStrategy planStrategy(const SortProfile* profile, int n, size_t max_extra_bytes) {
+    sortTuningInit();
+    SortCostInputs inputs;
+    sortCostInputsFromProfile(profile, n, &inputs);
+    return planStrategyCosts(&inputs, max_extra_bytes, NULL);
+}
+
+// planStrategy on prepared inputs; costs, if not NULL, receives the
+// prediction of every engine, including those over the budget.
+static SortStrategy planStrategyCosts(const SortCostInputs* inputs, size_t max_extra_bytes, double costs[]) {
+    SortStrategy best = STRATEGY_QUICKSORT;
+    double best_cost = HUGE_VAL;
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        bool fits = adaptiveHybridSortScratchSize(inputs->n, (SortStrategy)s) <= max_extra_bytes;
+        if (!fits && !costs) continue;
+        double cost = sortCostPredict((SortStrategy)s, inputs);
+        if (costs) costs[s] = cost;
+        if (fits && cost < best_cost) {
+            best_cost = cost;
+            best = (SortStrategy)s;
         }
     }
-    swap(&arr[i + 1], &arr[high]);
-    return (i + 1);
+    return best;
 }
 
-void quickSortRecursive(int arr[], int low, int high) {
-    if (low < high) {
-        // Switch to Insertion Sort for small subarrays
-        if (high - low + 1 < INSERTION_SORT_THRESHOLD) {
-            insertionSort(arr, low, high);
-        } else {
-            int pi = partition(arr, low, high);
-            quickSortRecursive(arr, low, pi - 1);
-            quickSortRecursive(arr, pi + 1, high);
-        }
+/*
+ * The decision a sort call makes, shared by adaptiveHybridSortWithOptions and
+ * sortExplain: presorted input first, then the small-array cutoff and
+ * PROFILE_MIN_N, then the profile (from the workload-tag cache when decision
+ * is not NULL and the cached profile still matches) and the cost model.
+ */
+static void sortDecide(const int arr[], int n, const SortOptions* options, SortExplanation* plan,
+                       SortDecision** decision, bool* reused) {
+    SortOrder order = options ? options->order : SORT_ASCENDING;
+    uint64_t tag = options ? options->workload_tag : 0;
+    sortTuningInit();
+    plan->strategy = plan->planned = STRATEGY_INSERTION;
+    plan->reason = SORT_REASON_SMALL_ARRAY;
+    plan->profiled = false;
+    for (int s = 0; s < STRATEGY_COUNT; s++) plan->predicted_ns[s] = HUGE_VAL;
+    *reused = false;
+
+    int direction = n > 1 ? presortedDirection(arr, n, order) : 1;
+    if (direction != 0) {
+        plan->strategy = plan->planned = STRATEGY_NATURAL_MERGE; // A single run
+        plan->reason = direction > 0 ? SORT_REASON_ALREADY_SORTED : SORT_REASON_REVERSED;
+        return;
+    }
+    if (n < smallSortCutoff()) return;
+    // Here the profile costs about as much as the sort. Quicksort partitions
+    // such inputs into insertion-sorted ranges, and the engines the profile
+    // could pick instead win by less than it costs.
+    if (n < PROFILE_MIN_N) {
+        plan->strategy = plan->planned = STRATEGY_QUICKSORT;
+        plan->reason = SORT_REASON_NOT_PROFILED;
+        return;
+    }
+
+    if (decision && tag) {
+        *decision = decisionSlot(tag);
+        *reused = decisionReuse(*decision, tag, arr, n, order);
+    }
+    if (*reused) {
+        plan->profile = (*decision)->profile;
+    } else {
+        profileData(arr, n, order, &plan->profile);
+        if (decision && *decision) decisionStore(*decision, tag, arr, n, order, &plan->profile);
+    }
+    plan->profiled = true;
+    sortCostInputsFromProfile(&plan->profile, n, &plan->inputs);
+    // A caller workspace promises a call without heap allocation; starting
+    // threads allocates their stacks.
+    if (options && options->workspace) plan->inputs.threads = 1;
+    plan->planned = planStrategyCosts(&plan->inputs, SIZE_MAX, plan->predicted_ns);
+    plan->strategy = plan->planned;
+    plan->reason = SORT_REASON_LOWEST_COST;
+    if (options && options->limit_memory) {
+        plan->strategy = planStrategyCosts(&plan->inputs, options->max_extra_bytes, NULL);
+        if (plan->strategy != plan->planned) plan->reason = SORT_REASON_MEMORY_BUDGET;
     }
 }
 
-void quickSort(int arr[], int low, int high) {
-    quickSortRecursive(arr, low, high);
+/**
+ * @brief Explains how adaptiveHybridSortWithOptions would sort arr: the
+ *        engine, the reason, the measured features and every engine's
+ *        predicted cost. Always profiles the input (the workload-tag cache is
+ *        neither used nor updated) and does not sort.
+ */
+void sortExplain(const int arr[], int n, const SortOptions* options, SortExplanation* explanation) {
+    bool reused;
+    sortDecide(arr, n, options, explanation, NULL, &reused);
+}
+
+const char* sortReasonName(SortReason reason) {
+    switch (reason) {
+        case SORT_REASON_SMALL_ARRAY:    return "small array";
+        case SORT_REASON_ALREADY_SORTED: return "already sorted";
+        case SORT_REASON_REVERSED:       return "reversed run";
+        case SORT_REASON_LOWEST_COST:    return "lowest predicted cost";
+        case SORT_REASON_MEMORY_BUDGET:  return "lowest cost within memory budget";
+        case SORT_REASON_NO_SCRATCH:     return "scratch memory unavailable";
+        case SORT_REASON_NOT_PROFILED:   return "too small to profile";
+        default:                         return "unknown";
+    }
 }
 
+void sortCostGetCoefficients(SortStrategy strategy, SortCostCoefficients* coefficients) {
+    sortTuningInit();
+    sortTuningLock();
+    if (strategy >= 0 && strategy < STRATEGY_COUNT) *coefficients = sort_cost_table[strategy];
+    sortTuningUnlock();
+}
 
-// --- Merge Sort ---
-void merge(int arr[], int l, int m, int r) {
-    int i, j, k;
-    int n1 = m - l + 1;
-    int n2 = r - m;
+/**
+ * @brief Replaces one engine's cost coefficients. Like the other tuning
+ *        setters, must not run while other threads sort (see Host Tuning).
+ */
+void sortCostSetCoefficients(SortStrategy strategy, const SortCostCoefficients* coefficients) {
+    sortTuningInit(); // A tuning file loaded later must not override this
+    sortTuningLock();
+    if (strategy >= 0 && strategy < STRATEGY_COUNT) sort_cost_table[strategy] = *coefficients;
+    sortTuningUnlock();
+}
 
-    int* L = (int*)malloc(n1 * sizeof(int));
-    int* R = (int*)malloc(n2 * sizeof(int));
-    if (!L || !R) {
-        if (L) free(L);
-        if (R) free(R);
-        return; // Memory allocation failed
-    }
+// Copies the whole cost table.
+static void sortCostGetTable(SortCostCoefficients table[]) {
+    sortTuningLock();
+    memcpy(table, sort_cost_table, sizeof(sort_cost_table));
+    sortTuningUnlock();
+}
 
-    for (i = 0; i < n1; i++) L[i] = arr[l + i];
-    for (j = 0; j < n2; j++) R[j] = arr[m + 1 + j];
+// --- Host Tuning ---
+/*
+ * The cost coefficients and the small-array cutoff default to values fitted
+ * on one x86-64 machine; crossovers on other hosts differ by several times.
+ * sortCalibrate times the engines on this host, refits the coefficients and
+ * the cutoff, and writes them to a tuning file. Before the first sort, the
+ * file named by the POLYSORT_TUNING environment variable is loaded; when it
+ * is unset or unreadable the built-in defaults stay in effect. The chunked
+ * sort uses one thread per online CPU, up to CHUNKED_SORT_MAX_THREADS,
+ * unless the file sets fewer.
+ *
+ * The file is plain text, one setting per line ('#' starts a comment):
+ *     small_sort_cutoff 24
+ *     threads 4
+ *     cost <strategy name> <fixed> <per_unit> <per_extra>
+ * Unknown settings are ignored.
+ *
+ * The tuning is process-wide and sorts read it without a lock. Loading a
+ * file, setting coefficients and calibrating take sort_tuning_lock, so they
+ * are safe against each other and each publishes its values in one step,
+ * but none of them may run while another thread is sorting. Calibration
+ * times its candidates with explicit cutoffs and only publishes at the end.
+ */
+static const char* const strategy_names[STRATEGY_COUNT] = {
+    [STRATEGY_MERGESORT]     = "mergesort",
+    [STRATEGY_RADIXSORT]     = "radixsort",
+    [STRATEGY_QUICKSORT]     = "quicksort",
+    [STRATEGY_MSD_RADIX]     = "msd_radix",
+    [STRATEGY_BLOCK_MERGE]   = "block_merge",
+    [STRATEGY_INSERTION]     = "insertion",
+    [STRATEGY_NATURAL_MERGE] = "natural_merge",
+    [STRATEGY_KWAY_MERGE]    = "kway_merge",
+    [STRATEGY_COUNTINGSORT]  = "countingsort",
+    [STRATEGY_CHUNKED]       = "chunked",
+};
 
-    i = 0; j = 0; k = l;
-    while (i < n1 && j < n2) {
-        if (L[i] <= R[j]) arr[k++] = L[i++];
-        else arr[k++] = R[j++];
-    }
+static int small_sort_cutoff = INSERTION_SORT_THRESHOLD;
+static int sort_threads = 1; // Online CPUs, up to CHUNKED_SORT_MAX_THREADS
 
-    while (i < n1) arr[k++] = L[i++];
-    while (j < n2) arr[k++] = R[j++];
+const char* strategyName(SortStrategy strategy) {
+    return (strategy >= 0 && strategy < STRATEGY_COUNT) ? strategy_names[strategy] : "unknown";
+}
 
-    free(L);
-    free(R);
+static int smallSortCutoff(void) {
+    return small_sort_cutoff;
 }
 
-void mergeSort(int arr[], int l, int r) {
-    if (l < r) {
-        int m = l + (r - l) / 2;
-        mergeSort(arr, l, m);
-        mergeSort(arr, m + 1, r);
-        merge(arr, l, m, r);
-    }
+// Threads the chunked sort may use.
+static int sortThreads(void) {
+    sortTuningInit();
+    return sort_threads;
 }
 
-// --- Radix Sort ---
-int getMax(int arr[], int n) {
-    int max = arr[0];
-    for (int i = 1; i < n; i++) {
-        if (arr[i] > max) max = arr[i];
+// Parses a tuning file and applies it only if every setting is valid.
+static bool sortTuningRead(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    SortCostCoefficients table[STRATEGY_COUNT];
+    sortCostGetTable(table);
+    int cutoff = small_sort_cutoff;
+    int threads = sort_threads;
+    bool ok = true;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), f)) {
+        char key[64], name[64];
+        SortCostCoefficients c;
+        if (sscanf(line, "%63s", key) != 1 || key[0] == '#') continue;
+        if (strcmp(key, "small_sort_cutoff") == 0) {
+            ok = sscanf(line, "%*s %d", &cutoff) == 1 && cutoff >= 2 && cutoff <= CALIBRATION_MAX_CUTOFF;
+        } else if (strcmp(key, "threads") == 0) {
+            ok = sscanf(line, "%*s %d", &threads) == 1 && threads >= 1 && threads <= CHUNKED_SORT_MAX_THREADS;
+        } else if (strcmp(key, "cost") == 0) {
+            ok = sscanf(line, "%*s %63s %lf %lf %lf", name, &c.fixed, &c.per_unit, &c.per_extra) == 4 &&
+                 c.fixed >= 0.0 && c.per_unit > 0.0 && c.per_extra >= 0.0;
+            int s = 0;
+            while (ok && s < STRATEGY_COUNT && strcmp(name, strategy_names[s]) != 0) s++;
+            if (ok && s < STRATEGY_COUNT) table[s] = c; // Unknown engines are skipped
+        }
     }
-    return max;
+    fclose(f);
+    if (!ok) return false;
+    sortTuningLock();
+    memcpy(sort_cost_table, table, sizeof(table));
+    small_sort_cutoff = cutoff;
+    sort_threads = threads;
+    sortTuningUnlock();
+    return true;
+}
+
+static void sortTuningLoadFromEnv(void) {
+#if defined(__linux__)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    sort_threads = cpus < 1 ? 1 : cpus > CHUNKED_SORT_MAX_THREADS ? CHUNKED_SORT_MAX_THREADS : (int)cpus;
+#endif
+    const char* path = getenv(SORT_TUNING_ENV);
+    if (path && *path) sortTuningRead(path); // Defaults stay on failure
 }
 
-void countingSortForRadix(int arr[], int n, int exp) {
-    int* output = (int*)malloc(n * sizeof(int));
-    int count[10] = {0};
-    if (!output) return; // Failsafe
+#if defined(__linux__)
+static pthread_once_t sort_tuning_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sort_tuning_lock = PTHREAD_MUTEX_INITIALIZER; // Serializes the tuning writers
+#else
+static bool sort_tuning_loaded = false; // Call a sort once before starting threads
+#endif
+
+static void sortTuningLock(void) {
+#if defined(__linux__)
+    pthread_mutex_lock(&sort_tuning_lock);
+#endif
+}
+
+static void sortTuningUnlock(void) {
+#if defined(__linux__)
+    pthread_mutex_unlock(&sort_tuning_lock);
+#endif
+}
 
-    for (int i = 0; i < n; i++) count[(arr[i] / exp) % 10]++;
-    for (int i = 1; i < 10; i++) count[i] += count[i - 1];
-    for (int i = n - 1; i >= 0; i--) {
-        output[count[(arr[i] / exp) % 10] - 1] = arr[i];
-        count[(arr[i] / exp) % 10]--;
+// Loads the tuning file named by POLYSORT_TUNING, once per process.
+static void sortTuningInit(void) {
+#if defined(__linux__)
+    pthread_once(&sort_tuning_once, sortTuningLoadFromEnv);
+#else
+    if (!sort_tuning_loaded) {
+        sort_tuning_loaded = true;
+        sortTuningLoadFromEnv();
     }
-    for (int i = 0; i < n; i++) arr[i] = output[i];
-    
-    free(output);
+#endif
 }
 
-void radixSort(int arr[], int n) {
-    int m = getMax(arr, n);
-    for (int exp = 1; m / exp > 0; exp *= 10) {
-        countingSortForRadix(arr, n, exp);
+/**
+ * @brief Loads a tuning file written by sortCalibrate or sortTuningSave.
+ * @return false, leaving the current tuning unchanged, if the file cannot be
+ *         read or holds an invalid setting.
+ */
+bool sortTuningLoad(const char* path) {
+    sortTuningInit();
+    return sortTuningRead(path);
+}
+
+/**
+ * @brief Writes the current tuning (cutoff and cost coefficients) to path.
+ */
+bool sortTuningSave(const char* path) {
+    sortTuningInit();
+    SortCostCoefficients table[STRATEGY_COUNT];
+    sortTuningLock();
+    memcpy(table, sort_cost_table, sizeof(table));
+    int cutoff = small_sort_cutoff, threads = sort_threads;
+    sortTuningUnlock();
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "# PolySort tuning file, loaded via %s\n", SORT_TUNING_ENV);
+    fprintf(f, "small_sort_cutoff %d\n", cutoff);
+    fprintf(f, "threads %d\n", threads);
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        const SortCostCoefficients* c = &table[s];
+        fprintf(f, "cost %s %.6g %.6g %.6g\n", strategy_names[s], c->fixed, c->per_unit, c->per_extra);
     }
+    return fclose(f) == 0;
 }
 
+// Inputs the engines are timed on.
+typedef enum {
+    CALIBRATE_RANDOM,     // Uniform 31-bit keys
+    CALIBRATE_KEYS_16,    // Two varying key bytes
+    CALIBRATE_RANGE_1000, // Narrow range, for counting sort
+    CALIBRATE_RUNS_8,     // Presorted runs with overlapping key ranges
+    CALIBRATE_RUNS_64
+} CalibrationInput;
+
+static const struct {
+    SortStrategy strategy;
+    CalibrationInput input;
+} calibration_plan[] = {
+    {STRATEGY_MERGESORT, CALIBRATE_RANDOM},
+    {STRATEGY_RADIXSORT, CALIBRATE_RANDOM},
+    {STRATEGY_RADIXSORT, CALIBRATE_KEYS_16},
+    {STRATEGY_QUICKSORT, CALIBRATE_RANDOM},
+    {STRATEGY_MSD_RADIX, CALIBRATE_RANDOM},
+    {STRATEGY_MSD_RADIX, CALIBRATE_KEYS_16},
+    {STRATEGY_BLOCK_MERGE, CALIBRATE_RANDOM},
+    {STRATEGY_NATURAL_MERGE, CALIBRATE_RUNS_64},
+    {STRATEGY_KWAY_MERGE, CALIBRATE_RUNS_8},
+    {STRATEGY_COUNTINGSORT, CALIBRATE_RANGE_1000},
+    {STRATEGY_CHUNKED, CALIBRATE_RANDOM},
+};
 
-// =============================================================================
-// 6. UTILITY AND HELPER FUNCTIONS
-// =============================================================================
+static double sortClockNow(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-void printArray(const char* label, const int arr[], int n) {
-    printf("%s: [", label);
-    for (int i = 0; i < n; ++i) {
-        printf("%d", arr[i]);
-        if (i < n - 1) printf(", ");
+static void calibrationFill(int arr[], int n, CalibrationInput input, uint64_t* state) {
+    int run_length = n / ((input == CALIBRATE_RUNS_8) ? 8 : 64) + 1;
+    for (int i = 0; i < n; i++) {
+        *state ^= *state << 13; // xorshift64
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        switch (input) {
+            case CALIBRATE_RANDOM:     arr[i] = (int)(*state >> 33); break;
+            case CALIBRATE_KEYS_16:    arr[i] = (int)(*state >> 48); break;
+            case CALIBRATE_RANGE_1000: arr[i] = (int)(*state % 1000); break;
+            default:                   arr[i] = (i % run_length) * 64 + i / run_length; break;
+        }
     }
-    printf("]\n");
 }
 
-void swap(int* a, int* b) {
-    int t = *a;
-    *a = *b;
-    *b = t;
+// cutoff is the small-array cutoff quicksort runs with; the other engines
+// use the current one.
+static void calibrationRun(SortStrategy strategy, int arr[], int n, int buf[], int cutoff) {
+    if (strategy == STRATEGY_QUICKSORT) quickSortWithCutoff(arr, 0, n - 1, SORT_ASCENDING, cutoff);
+    else runStrategy(arr, n, SORT_ASCENDING, strategy, buf, (size_t)n * sizeof(int));
 }
 
-int compareInts(const void* a, const void* b) {
-    return (*(int*)a - *(int*)b);
+// Seconds one engine takes on src, repeated until min_seconds.
+static double calibrationTime(SortStrategy strategy, const int src[], int work[], int buf[], int n, int cutoff,
+                              double min_seconds) {
+    double total = 0.0;
+    int reps = 0;
+    do {
+        memcpy(work, src, (size_t)n * sizeof(int));
+        double start = sortClockNow();
+        calibrationRun(strategy, work, n, buf, cutoff);
+        total += sortClockNow() - start;
+        reps++;
+    } while (total < min_seconds);
+    return total / reps;
 }
 
+static int compareDoubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
 
-// =============================================================================
-// 7. DEMONSTRATION IN MAIN
-// =============================================================================
+// Median of count timings; reorders them.
+static double calibrationMedian(double samples[], int count) {
+    qsort(samples, (size_t)count, sizeof(double), compareDoubles);
+    return samples[count / 2];
+}
 
-int main() {
-    srand(time(NULL));
+/**
+ * @brief Times the engines on this host, refits the cost coefficients and the
+ *        small-array cutoff, applies them and writes them to path.
+ *
+ * Each engine's per_unit coefficient is fitted on the inputs it is chosen for
+ * at three sizes up to CALIBRATION_MAX_N, which also captures the radix vs
+ * comparison crossover by n and key width. The cutoff minimizes the time
+ * lost by insertion sort below it and saved by it above it, on medians of
+ * repeated timings against engines that do not fall back to insertion sort
+ * themselves. Takes a few seconds and about 12MB of memory. The results are
+ * applied at the end; do not call it while other threads sort.
+ * @param path The tuning file to write, or NULL to only apply the results.
+ * @return false if memory could not be allocated or the file not written.
+ */
+bool sortCalibrate(const char* path) {
+    sortTuningInit();
+    int* src = malloc(CALIBRATION_MAX_N * sizeof(int));
+    int* work = malloc(CALIBRATION_MAX_N * sizeof(int));
+    int* buf = malloc(CALIBRATION_MAX_N * sizeof(int));
+    if (!src || !work || !buf) {
+        free(src);
+        free(work);
+        free(buf);
+        return false;
+    }
+    uint64_t state = 88172645463325252ull;
+    int current_cutoff = smallSortCutoff();
+    SortCostCoefficients table[STRATEGY_COUNT];
+    sortCostGetTable(table);
 
-    printf("--- Adaptive Hybrid Sort Demonstration ---\n\n");
+    // Per-unit coefficients, averaged over the plan and three sizes.
+    double sum[STRATEGY_COUNT] = {0};
+    int samples[STRATEGY_COUNT] = {0};
+    const int sizes[] = {CALIBRATION_MAX_N >> 6, CALIBRATION_MAX_N >> 3, CALIBRATION_MAX_N};
+    for (size_t p = 0; p < sizeof(calibration_plan) / sizeof(calibration_plan[0]); p++) {
+        SortStrategy strategy = calibration_plan[p].strategy;
+        for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+            int n = sizes[k];
+            calibrationFill(src, n, calibration_plan[p].input, &state);
+            SortProfile profile;
+            SortCostInputs inputs;
+            double units, extra;
+            profileData(src, n, SORT_ASCENDING, &profile);
+            sortCostInputsFromProfile(&profile, n, &inputs);
+            if (!sortCostUnits(strategy, &inputs, &units, &extra)) continue;
+            const SortCostCoefficients* c = &table[strategy];
+            double ns = calibrationTime(strategy, src, work, buf, n, current_cutoff, CALIBRATION_MIN_SECONDS) * 1e9 -
+                        c->fixed - c->per_extra * extra;
+            if (ns <= 0.0) continue;
+            sum[strategy] += ns / ((double)n * units);
+            samples[strategy]++;
+        }
+    }
 
-    // Case 1: Nearly sorted data
-    int nearly_sorted[] = {1, 2, 3, 10, 5, 6, 7, 8, 9, 4, 11, 12};
-    int n1 = sizeof(nearly_sorted) / sizeof(nearly_sorted[0]);
-    printArray("Case 1 (Nearly Sorted) - Before", nearly_sorted, n1);
-    adaptiveHybridSort(nearly_sorted, n1);
-    printArray("Case 1 (Nearly Sorted) - After ", nearly_sorted, n1);
-    printf("\n--------------------------------------------\n\n");
+    // Small-array cutoff. Per size, the median of CALIBRATION_CUTOFF_SAMPLES
+    // timings of insertion sort and of the fastest engine without a cutoff
+    // of its own: quicksort partitions all the way down, timed with a cutoff
+    // of 2, and merge and radix sort never hand ranges to insertion sort. The
+    // cutoff is the one that would have wasted the least time over all the
+    // sizes, so a single noisy size cannot move it far.
+    enum { CUTOFF_SIZES = CALIBRATION_MAX_CUTOFF / 8 };
+    double t_insertion[CUTOFF_SIZES], t_other[CUTOFF_SIZES];
+    double sample_seconds = CALIBRATION_MIN_SECONDS / CALIBRATION_CUTOFF_SAMPLES;
+    const SortStrategy others[] = {STRATEGY_QUICKSORT, STRATEGY_MERGESORT, STRATEGY_RADIXSORT};
+    const int others_count = (int)(sizeof(others) / sizeof(others[0]));
+    double insertion_sum = 0.0;
+    for (int k = 0; k < CUTOFF_SIZES; k++) {
+        int n = 8 * (k + 1);
+        calibrationFill(src, n, CALIBRATE_RANDOM, &state);
+        double samples_ins[CALIBRATION_CUTOFF_SAMPLES];
+        double samples_other[sizeof(others) / sizeof(others[0])][CALIBRATION_CUTOFF_SAMPLES];
+        for (int r = 0; r < CALIBRATION_CUTOFF_SAMPLES; r++) { // Interleaved, so drift hits all alike
+            samples_ins[r] = calibrationTime(STRATEGY_INSERTION, src, work, buf, n, 2, sample_seconds);
+            for (int e = 0; e < others_count; e++) {
+                samples_other[e][r] = calibrationTime(others[e], src, work, buf, n, 2, sample_seconds);
+            }
+        }
+        t_insertion[k] = calibrationMedian(samples_ins, CALIBRATION_CUTOFF_SAMPLES);
+        t_other[k] = HUGE_VAL;
+        for (int e = 0; e < others_count; e++) {
+            t_other[k] = fmin(t_other[k], calibrationMedian(samples_other[e], CALIBRATION_CUTOFF_SAMPLES));
+        }
+        insertion_sum += t_insertion[k] * 1e9 / ((double)n * n / 4.0);
+    }
 
-    // Case 2: Non-negative integers (ideal for Radix Sort)
-    int positive_ints[] = {170, 45, 75, 90, 802, 24, 2, 66};
-    int n2 = sizeof(positive_ints) / sizeof(positive_ints[0]);
-    printArray("Case 2 (Positive Integers) - Before", positive_ints, n2);
-    adaptiveHybridSort(positive_ints, n2);
-    printArray("Case 2 (Positive Integers) - After ", positive_ints, n2);
-    printf("\n--------------------------------------------\n\n");
+    // Insertion sort runs below the cutoff: the loss of a cutoff is the time
+    // insertion sort loses below it plus the time it would have saved above.
+    int cutoff = CALIBRATION_MAX_CUTOFF;
+    double best_loss = HUGE_VAL;
+    for (int c = 0; c < CUTOFF_SIZES; c++) {
+        double loss = 0.0;
+        for (int k = 0; k < CUTOFF_SIZES; k++) {
+            loss += k < c ? fmax(t_insertion[k] - t_other[k], 0.0) : fmax(t_other[k] - t_insertion[k], 0.0);
+        }
+        if (loss < best_loss) {
+            best_loss = loss;
+            cutoff = 8 * (c + 1); // Sizes below it, 8 .. 8c, use insertion sort
+        }
+    }
+    free(src);
+    free(work);
+    free(buf);
 
-    // Case 3: Random data with negatives (default to Quicksort)
-    int random_data[] = {9, -3, 5, 2, 6, 8, -6, 1, 3, 4, 15, 0, -10};
-    int n3 = sizeof(random_data) / sizeof(random_data[0]);
-    printArray("Case 3 (Random w/ Negatives) - Before", random_data, n3);
-    adaptiveHybridSort(random_data, n3);
-    printArray("Case 3 (Random w/ Negatives) - After ", random_data, n3);
-    printf("\n--------------------------------------------\n\n");
+    // Published together at the end; sorts never see a half-fitted table.
+    sortTuningLock();
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        if (samples[s]) sort_cost_table[s].per_unit = sum[s] / samples[s];
+    }
+    sort_cost_table[STRATEGY_INSERTION].per_unit = insertion_sum / CUTOFF_SIZES;
+    small_sort_cutoff = cutoff;
+    sortTuningUnlock();
+    return path ? sortTuningSave(path) : true;
+}
 
-    // Case 4: Small array (will use Insertion Sort)
-    int small_array[] = {5, 1, 4, 2, 8};
-    int n4 = sizeof(small_array) / sizeof(small_array[0]);
-    printArray("Case 4 (Small Array) - Before", small_array, n4);
-    adaptiveHybridSort(small_array, n4);
-    printArray("Case 4 (Small Array) - After ", small_array, n4);
+/*
+ * HyperLogLog sketch for the distinct-value estimate. Keys are hashed in
+ * batches of HLL_BLOCK by a branch-free loop of 32-bit multiplies and shifts
+ * over a contiguous block of gathered keys (vectorized at -O2); each hash
+ * then raises one of the 2^HLL_PRECISION registers to the position of its
+ * first set bit after the index bits. Small counts switch to linear counting
+ * over the empty registers, so the estimate stays accurate from a few values
+ * up to the full sample. Samples of at most DISTINCT_EXACT_MAX keys skip the
+ * sketch: the same hashes index a set of the keys, which costs less than
+ * summing the registers and counts exactly.
+ */
+static inline uint32_t hashKey32(uint32_t x) { // MurmurHash3 finalizer
+    x ^= x >> 16;
+    x *= 0x85ebca6bu;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35u;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline int leadingZeros32(uint32_t x) { // x != 0
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clz(x);
+#else
+    int z = 0;
+    while (!(x & 0x80000000u)) { x <<= 1; z++; }
+    return z;
+#endif
+}
+
+static void sketchAdd(CardinalitySketch* sketch, const uint32_t hashes[], int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t h = hashes[i];
+        uint32_t index = h >> (32 - HLL_PRECISION);
+        uint32_t rest = (h << HLL_PRECISION) | (1u << (HLL_PRECISION - 1)); // Caps the rank
+        uint8_t rank = (uint8_t)(leadingZeros32(rest) + 1);
+        if (rank > sketch->reg[index]) sketch->reg[index] = rank;
+    }
+}
+
+static double sketchEstimate(const CardinalitySketch* sketch) {
+    // The sum of 2^-reg[i], scaled by 2^HLL_MAX_RANK into an exact integer.
+    enum { HLL_MAX_RANK = 32 - HLL_PRECISION + 1 };
+    const int m = 1 << HLL_PRECISION;
+    uint64_t scaled_sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < m; i++) {
+        scaled_sum += (uint64_t)1 << (HLL_MAX_RANK - sketch->reg[i]);
+        zeros += sketch->reg[i] == 0;
+    }
+    double sum = ldexp((double)scaled_sum, -HLL_MAX_RANK);
+    double estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * log((double)m / zeros); // Linear counting
+    }
+    return estimate;
+}
+
+// capacity: the most keys that will be added, at most DISTINCT_EXACT_MAX.
+static void distinctSetInit(DistinctSet* set, int capacity) {
+    uint32_t size = 2;
+    while (size < 2u * (uint32_t)capacity) size *= 2; // At most half full
+    memset(set->used, 0, size * sizeof(bool));
+    set->mask = size - 1;
+    set->count = 0;
+}
+
+static void distinctSetAdd(DistinctSet* set, const int keys[], const uint32_t hashes[], int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = hashes[i] & set->mask;
+        while (set->used[slot] && set->keys[slot] != keys[i]) slot = (slot + 1) & set->mask;
+        if (!set->used[slot]) {
+            set->used[slot] = true;
+            set->keys[slot] = keys[i];
+            set->count++;
+        }
+    }
+}
+
+// --- Workload-Tag Decision Cache ---
+/*
+ * Services often sort the same kind of array again and again (one column,
+ * similar sizes and distributions). A caller can name that workload with
+ * SortOptions.workload_tag; the calling thread then keeps the tag's profile
+ * in a small direct-mapped cache and skips the full analysis on later calls
+ * of a similar size. Before a cached profile is reused, DECISION_SPOT_CHECKS
+ * neighbouring pairs are read: their in-order share must stay close to the
+ * cached one and their keys inside the cached range (with some slack).
+ * Every DECISION_REVALIDATE_CALLS reuses, or when a reused plan runs
+ * DECISION_SLOWDOWN times slower than its average, the input is analyzed
+ * again. The plan is recomputed from the cached profile on every call, so a
+ * different memory budget still applies.
+ */
+static _Thread_local struct {
+    SortDecision slots[DECISION_CACHE_SLOTS];
+    SortDecisionCacheStats stats;
+} decision_cache;
+
+static SortDecision* decisionSlot(uint64_t tag) {
+    uint64_t h = tag * 0x9E3779B97F4A7C15ull; // Fibonacci hashing
+    return &decision_cache.slots[(h >> 32) % DECISION_CACHE_SLOTS];
+}
+
+// Reads DECISION_SPOT_CHECKS evenly spaced neighbouring pairs; returns the
+// share that is in order and the smallest and largest key read.
+static double spotCheck(const int arr[], int n, SortOrder order, int* lo_key, int* hi_key) {
+    int lo = arr[0], hi = arr[0], in_order = 0;
+    for (int k = 0; k < DECISION_SPOT_CHECKS; k++) {
+        int i = (int)((long long)k * (n - 1) / DECISION_SPOT_CHECKS);
+        int a = arr[i], b = arr[i + 1];
+        in_order += !KEY_PRECEDES(b, a, order);
+        lo = a < lo ? a : lo;
+        hi = a > hi ? a : hi;
+        lo = b < lo ? b : lo;
+        hi = b > hi ? b : hi;
+    }
+    *lo_key = lo;
+    *hi_key = hi;
+    return (double)in_order / DECISION_SPOT_CHECKS;
+}
+
+// True if the decision's cached profile may be used for this input.
+static bool decisionReuse(SortDecision* decision, uint64_t tag, const int arr[], int n, SortOrder order) {
+    if (decision->tag != tag || decision->order != order || n < decision->n / 2 || n > decision->n * 2 ||
+        decision->uses >= DECISION_REVALIDATE_CALLS) {
+        decision_cache.stats.misses++;
+        return false;
+    }
+    int lo, hi;
+    double ratio = spotCheck(arr, n, order, &lo, &hi);
+    long long slack = ((long long)decision->profile.max_value - decision->profile.min_value) / 4;
+    if (fabs(ratio - decision->in_order_ratio) > 0.25 || lo < decision->profile.min_value - slack ||
+        hi > decision->profile.max_value + slack) {
+        decision_cache.stats.spot_check_failures++;
+        decision_cache.stats.misses++;
+        return false;
+    }
+    decision->in_order_ratio = 0.75 * decision->in_order_ratio + 0.25 * ratio; // Smooths sampling noise
+    decision->uses++;
+    decision_cache.stats.hits++;
+    return true;
+}
+
+static void decisionStore(SortDecision* decision, uint64_t tag, const int arr[], int n, SortOrder order,
+                          const SortProfile* profile) {
+    int lo, hi;
+    decision->tag = tag;
+    decision->n = n;
+    decision->order = order;
+    decision->profile = *profile;
+    decision->in_order_ratio = spotCheck(arr, n, order, &lo, &hi);
+    decision->ns_per_element = 0.0;
+    decision->uses = 0;
+}
+
+// Folds one call's time into the decision; drops a reused plan that ran slow.
+static void decisionRecordTime(SortDecision* decision, int n, double seconds, bool reused) {
+    double ns = seconds * 1e9 / n;
+    if (reused && decision->ns_per_element > 0.0 && ns > DECISION_SLOWDOWN * decision->ns_per_element) {
+        decision->tag = 0;
+        decision_cache.stats.slow_invalidations++;
+        return;
+    }
+    decision->ns_per_element = decision->ns_per_element > 0.0 ? 0.75 * decision->ns_per_element + 0.25 * ns : ns;
+}
+
+/**
+ * @brief Copies the calling thread's workload-tag cache counters into stats.
+ */
+void sortDecisionCacheGetStats(SortDecisionCacheStats* stats) {
+    *stats = decision_cache.stats;
+}
+
+/**
+ * @brief Forgets the calling thread's cached analyses and clears its counters.
+ */
+void sortDecisionCacheClear(void) {
+    memset(&decision_cache, 0, sizeof(decision_cache));
+}
+
+
+// =============================================================================
+// 5. SCRATCH MEMORY (WORKSPACES)
+// =============================================================================
+
+/**
+ * @brief Reports the scratch memory a strategy needs to sort n ints.
+ * @param n The number of elements.
+ * @param strategy The strategy that will run.
+ * @return The size in bytes; 0 for in-place strategies.
+ */
+size_t adaptiveHybridSortScratchSize(int n, SortStrategy strategy) {
+    if (n <= 1) return 0;
+    switch (strategy) {
+        case STRATEGY_MERGESORT:
+            return (size_t)(n - n / 2) * sizeof(int); // Only the left run is copied
+        case STRATEGY_NATURAL_MERGE:
+            return (size_t)(n / 2) * sizeof(int); // Only the shorter run is copied
+        case STRATEGY_RADIXSORT:
+        case STRATEGY_KWAY_MERGE:
+        case STRATEGY_CHUNKED:
+            return (size_t)n * sizeof(int);
+        case STRATEGY_COUNTINGSORT:
+            return countingSortMaxRange(n) * COUNTING_SORT_LANES * sizeof(uint32_t);
+        case STRATEGY_QUICKSORT:
+        case STRATEGY_MSD_RADIX:
+        case STRATEGY_BLOCK_MERGE:
+        case STRATEGY_INSERTION:
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Picks the strategy to run when at most max_extra_bytes of scratch
+ *        may be used, downgrading to an engine with a smaller footprint.
+ * @return strategy itself if it fits, else the closest cheaper-memory engine:
+ *         LSD radix (n ints) and counting sort (<= n counters) -> in-place
+ *         MSD radix, k-way run merge (n ints)
+ *         -> natural merge (n/2 ints) -> block merge, merge (n/2 ints) ->
+ *         block merge, chunked sort (n ints) -> quicksort. In-place engines
+ *         only need O(log n) stack.
+ */
+SortStrategy strategyWithinBudget(SortStrategy strategy, int n, size_t max_extra_bytes) {
+    if (adaptiveHybridSortScratchSize(n, strategy) <= max_extra_bytes) return strategy;
+    switch (strategy) {
+        case STRATEGY_RADIXSORT:
+        case STRATEGY_COUNTINGSORT:
+            return STRATEGY_MSD_RADIX;
+        case STRATEGY_KWAY_MERGE:
+            return strategyWithinBudget(STRATEGY_NATURAL_MERGE, n, max_extra_bytes);
+        case STRATEGY_MERGESORT:
+        case STRATEGY_NATURAL_MERGE:
+            return STRATEGY_BLOCK_MERGE;
+        default:
+            return STRATEGY_QUICKSORT;
+    }
+}
+
+/*
+ * Callers that pass no workspace get their scratch from a per-thread arena
+ * that is reused across sort calls, so repeated medium-sized sorts stop paying
+ * for malloc and page faults on every call. The arena grows geometrically and
+ * is released after SCRATCH_CACHE_IDLE_CALLS calls that each used less than a
+ * quarter of it. On Linux a thread-specific key frees the arena when its
+ * thread exits; other builds should call scratchCacheTrim() before a thread
+ * exits.
+ */
+static _Thread_local struct {
+    void* arena;
+    bool in_use;             // Guards against re-entrant sorts on one thread
+    unsigned idle_calls;
+    ScratchCacheStats stats;
+} scratch_cache;
+
+#if defined(__linux__)
+static pthread_key_t scratch_cache_key;
+static pthread_once_t scratch_cache_key_once = PTHREAD_ONCE_INIT;
+static bool scratch_cache_key_ready;
+
+static void scratchCacheThreadExit(void* arena) {
+    free(arena);
+}
+
+static void scratchCacheKeyCreate(void) {
+    scratch_cache_key_ready = pthread_key_create(&scratch_cache_key, scratchCacheThreadExit) == 0;
+}
+#endif
+
+// Records the current arena as the one to free when this thread exits.
+static void scratchCacheRegister(void) {
+#if defined(__linux__)
+    pthread_once(&scratch_cache_key_once, scratchCacheKeyCreate);
+    if (scratch_cache_key_ready) pthread_setspecific(scratch_cache_key, scratch_cache.arena);
+#endif
+}
+
+static void* scratchCacheAcquire(size_t bytes) {
+    if (scratch_cache.in_use || bytes > SCRATCH_CACHE_MAX_BYTES) {
+        scratch_cache.stats.misses++;
+        return NULL;
+    }
+    if (scratch_cache.stats.capacity >= bytes) {
+        scratch_cache.stats.hits++;
+    } else {
+        size_t capacity = scratch_cache.stats.capacity * 2;
+        if (capacity < bytes) capacity = bytes;
+        if (capacity > SCRATCH_CACHE_MAX_BYTES) capacity = SCRATCH_CACHE_MAX_BYTES;
+        free(scratch_cache.arena);
+        scratch_cache.arena = malloc(capacity);
+        scratchCacheRegister();
+        if (!scratch_cache.arena) {
+            scratch_cache.stats.capacity = 0;
+            return NULL;
+        }
+        scratch_cache.stats.capacity = capacity;
+        scratch_cache.stats.growths++;
+    }
+    scratch_cache.in_use = true;
+    return scratch_cache.arena;
+}
+
+static void scratchCacheRelease(size_t bytes) {
+    scratch_cache.in_use = false;
+    if (bytes >= scratch_cache.stats.capacity / 4) {
+        scratch_cache.idle_calls = 0;
+    } else if (++scratch_cache.idle_calls >= SCRATCH_CACHE_IDLE_CALLS) {
+        scratchCacheTrim();
+        scratch_cache.stats.trims++;
+    }
+}
+
+/**
+ * @brief Copies the calling thread's scratch-cache counters into stats.
+ */
+void scratchCacheGetStats(ScratchCacheStats* stats) {
+    *stats = scratch_cache.stats;
+}
+
+/**
+ * @brief Releases the calling thread's cached scratch arena.
+ */
+void scratchCacheTrim(void) {
+    if (scratch_cache.in_use) return;
+    free(scratch_cache.arena);
+    scratch_cache.arena = NULL;
+    scratchCacheRegister();
+    scratch_cache.stats.capacity = 0;
+    scratch_cache.idle_calls = 0;
+}
+
+/*
+ * Huge-page scratch. The random scatter of radix passes and the merge passes
+ * over arrays of hundreds of MB touch far more 4KB pages than the TLB covers;
+ * 2MB pages cut the page-walk rate by 512x. We try explicit huge pages
+ * (MAP_HUGETLB) first, then an anonymous mapping advised for transparent huge
+ * pages, and pre-fault the mapping from several threads so the page-fault and
+ * zeroing cost is paid in parallel rather than inside the scatter loop.
+ */
+#if defined(__linux__)
+typedef struct {
+    volatile unsigned char* begin;
+    size_t bytes;
+} PrefaultSlice;
+
+static void* prefaultSlice(void* arg) {
+    PrefaultSlice* slice = (PrefaultSlice*)arg;
+    for (size_t off = 0; off < slice->bytes; off += 4096) slice->begin[off] = 0;
+    return NULL;
+}
+
+// Returns the number of threads started.
+static int prefaultParallel(unsigned char* mem, size_t bytes) {
+    pthread_t threads[HUGE_PAGE_PREFAULT_THREADS];
+    PrefaultSlice slices[HUGE_PAGE_PREFAULT_THREADS];
+    size_t per_thread = (bytes / HUGE_PAGE_PREFAULT_THREADS + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    int started = 0;
+    for (int t = 0; t < HUGE_PAGE_PREFAULT_THREADS; t++) {
+        size_t off = (size_t)t * per_thread;
+        if (off >= bytes) break;
+        slices[t].begin = mem + off;
+        slices[t].bytes = (off + per_thread < bytes) ? per_thread : bytes - off;
+        if (pthread_create(&threads[t], NULL, prefaultSlice, &slices[t]) != 0) {
+            prefaultSlice(&slices[t]); // Fault this slice on the calling thread
+            continue;
+        }
+        threads[started++] = threads[t];
+    }
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+    return started;
+}
+#endif
+
+// threads_started receives the number of prefault threads started.
+static void* hugePageAlloc(size_t bytes, int* threads_started) {
+    *threads_started = 0;
+#if defined(__linux__)
+    size_t mapped = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void* mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem == MAP_FAILED) {
+        mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return NULL;
+        madvise(mem, mapped, MADV_HUGEPAGE); // Best effort: THP may be disabled
+    }
+    *threads_started = prefaultParallel((unsigned char*)mem, mapped);
+    return mem;
+#else
+    (void)bytes;
+    return NULL;
+#endif
+}
+
+static void hugePageFree(void* mem, size_t bytes) {
+#if defined(__linux__)
+    munmap(mem, (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+#else
+    (void)mem;
+    (void)bytes;
+#endif
+}
+
+/*
+ * Scratch instrumentation. Every acquisition and release goes through
+ * scratchAcquire/scratchRelease, which keep per-thread running counters; a
+ * sort call snapshots them on entry and exit to get its own peak, volume and
+ * allocation count, and adds the result to per-thread, per-strategy totals.
+ * Page faults come from getrusage(RUSAGE_THREAD); that is a system call per
+ * snapshot, so it is opt-in through sortStatsEnablePageFaults.
+ */
+static _Thread_local struct {
+    size_t current_bytes;             // Scratch currently held by this thread
+    size_t peak_bytes;                // High-water mark since the last reset
+    unsigned long long bytes_total;   // Monotonic
+    unsigned long long allocations;   // Monotonic
+    unsigned long long threads_started; // Monotonic
+    bool page_faults;
+    SortThreadStats thread;
+} sort_stats;
+
+static void readPageFaults(long long* minor, long long* major) {
+#if defined(__linux__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        *minor = usage.ru_minflt;
+        *major = usage.ru_majflt;
+        return;
+    }
+#endif
+    *minor = *major = -1;
+}
+
+static void sortCallBegin(SortCallTracker* tracker) {
+    tracker->saved_peak = sort_stats.peak_bytes;
+    tracker->base_bytes = sort_stats.current_bytes;
+    tracker->bytes_total = sort_stats.bytes_total;
+    tracker->allocations = sort_stats.allocations;
+    tracker->threads_started = sort_stats.threads_started;
+    sort_stats.peak_bytes = sort_stats.current_bytes;
+    tracker->minor_faults = tracker->major_faults = -1;
+    if (sort_stats.page_faults) readPageFaults(&tracker->minor_faults, &tracker->major_faults);
+}
+
+static void sortCallEnd(SortCallTracker* tracker, SortStrategy strategy, SortMemoryStats* out) {
+    out->peak_scratch_bytes = sort_stats.peak_bytes - tracker->base_bytes;
+    out->scratch_bytes = sort_stats.bytes_total - tracker->bytes_total;
+    out->allocations = sort_stats.allocations - tracker->allocations;
+    out->threads_started = sort_stats.threads_started - tracker->threads_started;
+    out->minor_faults = out->major_faults = -1;
+    if (sort_stats.page_faults && tracker->minor_faults >= 0) {
+        long long minor, major;
+        readPageFaults(&minor, &major);
+        if (minor >= 0) {
+            out->minor_faults = minor - tracker->minor_faults;
+            out->major_faults = major - tracker->major_faults;
+        }
+    }
+    if (tracker->saved_peak > sort_stats.peak_bytes) sort_stats.peak_bytes = tracker->saved_peak;
+
+    SortStrategyStats* targets[2] = { &sort_stats.thread.by_strategy[strategy], &sort_stats.thread.total };
+    for (int i = 0; i < 2; i++) {
+        SortStrategyStats* t = targets[i];
+        t->calls++;
+        if (out->peak_scratch_bytes > t->peak_scratch_bytes) t->peak_scratch_bytes = out->peak_scratch_bytes;
+        t->scratch_bytes += out->scratch_bytes;
+        t->allocations += out->allocations;
+        t->threads_started += out->threads_started;
+        if (out->minor_faults >= 0) {
+            t->minor_faults += (unsigned long long)out->minor_faults;
+            t->major_faults += (unsigned long long)out->major_faults;
+        }
+    }
+}
+
+// Ends a sort call: fills in the caller's report, if any, and runs the
+// completion callback.
+static void sortCallFinish(SortCallTracker* tracker, SortCallInfo* info, size_t scratch_bytes,
+                           SortReport* report) {
+    SortMemoryStats memory;
+    sortCallEnd(tracker, info->used, &memory);
+    if (report) {
+        report->planned = info->planned;
+        report->used = info->used;
+        report->scratch_bytes = scratch_bytes;
+        report->memory_downgrade = info->used != info->planned;
+        report->analysis_cached = info->analysis_cached;
+        report->reason = info->reason;
+        report->memory = memory;
+    }
+    if (sort_completion.callback) sort_completion.callback(info, sort_completion.context);
+}
+
+/**
+ * @brief Copies the calling thread's per-strategy memory totals into stats.
+ */
+void sortStatsGetThread(SortThreadStats* stats) {
+    *stats = sort_stats.thread;
+}
+
+/**
+ * @brief Clears the calling thread's per-strategy memory totals.
+ */
+void sortStatsResetThread(void) {
+    memset(&sort_stats.thread, 0, sizeof(sort_stats.thread));
+}
+
+/**
+ * @brief Turns page-fault counting on or off for the calling thread.
+ */
+void sortStatsEnablePageFaults(bool enable) {
+    sort_stats.page_faults = enable;
+}
+
+/*
+ * Obtains `bytes` of scratch for one sort call: from the workspace buffer if
+ * it is large enough, else from the workspace allocator. Without a workspace,
+ * large requests may be backed by huge pages; otherwise the thread cache is
+ * used, then malloc. A workspace without a usable buffer or allocator never
+ * falls through to the global heap. Returns false if no memory was obtained.
+ */
+static bool scratchAcquire(SortWorkspace* workspace, size_t bytes, bool huge_pages, ScratchBlock* block) {
+    block->ptr = NULL;
+    block->bytes = bytes;
+    block->allocator = NULL;
+    block->source = SCRATCH_NONE;
+    if (bytes == 0) return true;
+    unsigned long long growths = scratch_cache.stats.growths; // Detects cache growth
+    int prefault_threads = 0; // Huge pages only, so never with a workspace
+
+    if (workspace) {
+        if (workspace->buffer && workspace->size >= bytes) {
+            block->ptr = workspace->buffer;
+            block->source = SCRATCH_BORROWED;
+        } else if (workspace->allocator) {
+            block->ptr = workspace->allocator->allocate(workspace->allocator->ctx, bytes);
+            block->allocator = workspace->allocator;
+            block->source = SCRATCH_ALLOCATOR;
+        }
+    } else if (huge_pages && bytes >= HUGE_PAGE_MIN_BYTES &&
+               (block->ptr = hugePageAlloc(bytes, &prefault_threads)) != NULL) {
+        block->source = SCRATCH_HUGE_PAGES;
+    } else if ((block->ptr = scratchCacheAcquire(bytes)) != NULL) {
+        block->source = SCRATCH_THREAD_CACHE;
+    } else {
+        block->ptr = malloc(bytes);
+        block->source = SCRATCH_HEAP;
+    }
+
+    if (!block->ptr) {
+        block->source = SCRATCH_NONE;
+        return false;
+    }
+
+    sort_stats.current_bytes += bytes;
+    sort_stats.bytes_total += bytes;
+    if (sort_stats.current_bytes > sort_stats.peak_bytes) sort_stats.peak_bytes = sort_stats.current_bytes;
+    if (block->source != SCRATCH_BORROWED &&
+        (block->source != SCRATCH_THREAD_CACHE || scratch_cache.stats.growths != growths)) {
+        sort_stats.allocations++;
+    }
+    sort_stats.allocations += (unsigned long long)prefault_threads; // Each thread maps a stack
+    sort_stats.threads_started += (unsigned long long)prefault_threads;
+    return true;
+}
+
+static void scratchRelease(ScratchBlock* block) {
+    if (block->source != SCRATCH_NONE) sort_stats.current_bytes -= block->bytes;
+    switch (block->source) {
+        case SCRATCH_ALLOCATOR:
+            block->allocator->deallocate(block->allocator->ctx, block->ptr, block->bytes);
+            break;
+        case SCRATCH_THREAD_CACHE:
+            scratchCacheRelease(block->bytes);
+            break;
+        case SCRATCH_HEAP:
+            free(block->ptr);
+            break;
+        case SCRATCH_HUGE_PAGES:
+            hugePageFree(block->ptr, block->bytes);
+            break;
+        case SCRATCH_BORROWED:
+        case SCRATCH_NONE:
+        default:
+            break;
+    }
+    block->ptr = NULL;
+    block->source = SCRATCH_NONE;
+}
+
+
+// =============================================================================
+// 6. IMPLEMENTATIONS OF CORE SORTING ALGORITHMS
+// =============================================================================
+
+/*
+ * The comparison kernels (insertion sort, the quicksort partition, the
+ * merges and their binary searches, the in-place merge, the run scan and
+ * heapsort) are generated once per direction by DEFINE_ORDERED_KERNELS, with
+ * the comparison hard-coded, so no kernel tests the direction inside its
+ * loop. The entry points take the SortOrder and dispatch once; the k-way
+ * merge complements its keys instead (see RunTree). Scans that only classify
+ * the input (profiling, run counting, reversing descending runs) still use
+ * KEY_PRECEDES.
+ */
+#define PRECEDES_ASCENDING(a, b) ((a) < (b))
+#define PRECEDES_DESCENDING(a, b) ((a) > (b))
+
+#define DEFINE_ORDERED_KERNELS(DIR, PRECEDES)                                   \
+static void insertionSort##DIR(int arr[], int left, int right) {               \
+    for (int i = left + 1; i <= right; i++) {                                  \
+        int key = arr[i];                                                      \
+        int j = i - 1;                                                         \
+        while (j >= left && PRECEDES(key, arr[j])) {                           \
+            arr[j + 1] = arr[j];                                               \
+            j = j - 1;                                                         \
+        }                                                                      \
+        arr[j + 1] = key;                                                      \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+static int partition##DIR(int arr[], int low, int high) {                      \
+    int pivot = arr[high];                                                     \
+    int i = (low - 1);                                                         \
+    for (int j = low; j <= high - 1; j++) {                                    \
+        if (PRECEDES(arr[j], pivot)) {                                         \
+            i++;                                                               \
+            swap(&arr[i], &arr[j]);                                            \
+        }                                                                      \
+    }                                                                          \
+    swap(&arr[i + 1], &arr[high]);                                             \
+    return (i + 1);                                                            \
+}                                                                              \
+                                                                               \
+/* Only the left run is copied into buf (m - l + 1 elements); the right run   \
+   is merged in place since the write cursor can never overtake it. */        \
+static void merge##DIR(int arr[], int l, int m, int r, int buf[]) {            \
+    int i, j, k;                                                               \
+    int n1 = m - l + 1;                                                        \
+    memcpy(buf, arr + l, n1 * sizeof(int));                                    \
+    i = 0; j = m + 1; k = l;                                                   \
+    while (i < n1 && j <= r) {                                                 \
+        if (!PRECEDES(arr[j], buf[i])) arr[k++] = buf[i++]; /* Stable */       \
+        else arr[k++] = arr[j++];                                              \
+    }                                                                          \
+    while (i < n1) arr[k++] = buf[i++];                                        \
+}                                                                              \
+                                                                               \
+static void mergeSort##DIR(int arr[], int l, int r, int buf[]) {               \
+    if (l < r) {                                                               \
+        int m = l + (r - l) / 2;                                               \
+        mergeSort##DIR(arr, l, m, buf);                                        \
+        mergeSort##DIR(arr, m + 1, r, buf);                                    \
+        merge##DIR(arr, l, m, r, buf);                                         \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+/* Stably merges the sorted runs [lo, mid) and [mid, hi), copying only the    \
+   shorter run into buf (min(mid - lo, hi - mid) elements). */                \
+static void mergeShorterRun##DIR(int arr[], int lo, int mid, int hi, int buf[]) { \
+    int len1 = mid - lo, len2 = hi - mid;                                      \
+    if (len1 <= len2) {                                                        \
+        memcpy(buf, arr + lo, len1 * sizeof(int));                             \
+        int i = 0, j = mid, k = lo;                                            \
+        while (i < len1 && j < hi) {                                           \
+            if (!PRECEDES(arr[j], buf[i])) arr[k++] = buf[i++];                \
+            else arr[k++] = arr[j++];                                          \
+        }                                                                      \
+        while (i < len1) arr[k++] = buf[i++];                                  \
+    } else {                                                                   \
+        memcpy(buf, arr + mid, len2 * sizeof(int));                            \
+        int i = mid - 1, j = len2 - 1, k = hi - 1;                             \
+        while (i >= lo && j >= 0) {                                            \
+            if (PRECEDES(buf[j], arr[i])) arr[k--] = arr[i--];                 \
+            else arr[k--] = buf[j--];                                          \
+        }                                                                      \
+        while (j >= 0) arr[k--] = buf[j--];                                    \
+    }                                                                          \
+}                                                                              \
+                                                                               \
+/* Number of elements the first k outputs of the stable merge of a and b     \
+   take from a (ties go to a). */                                             \
+static int mergePathSplit##DIR(const int a[], int la, const int b[], int lb, int k) { \
+    int lo = k > lb ? k - lb : 0;                                              \
+    int hi = k < la ? k : la;                                                  \
+    while (lo < hi) {                                                          \
+        int mid = lo + (hi - lo) / 2;                                          \
+        if (PRECEDES(b[k - mid - 1], a[mid])) hi = mid;                        \
+        else lo = mid + 1;                                                     \
+    }                                                                          \
+    return lo;                                                                 \
+}                                                                              \
+                                                                               \
+/* Stably merges a and b into out, which overlaps neither. */                 \
+static void mergeInto##DIR(const int a[], int la, const int b[], int lb, int out[]) { \
+    int i = 0, j = 0, k = 0;                                                   \
+    while (i < la && j < lb) out[k++] = PRECEDES(b[j], a[i]) ? b[j++] : a[i++]; \
+    memcpy(out + k, a + i, (size_t)(la - i) * sizeof(int));                    \
+    memcpy(out + k + (la - i), b + j, (size_t)(lb - j) * sizeof(int));         \
+}                                                                              \
+                                                                               \
+/* First position in [lo, hi) whose element does not precede key. */         \
+static int lowerBound##DIR(const int arr[], int lo, int hi, int key) {         \
+    while (lo < hi) {                                                          \
+        int mid = lo + (hi - lo) / 2;                                          \
+        if (PRECEDES(arr[mid], key)) lo = mid + 1;                             \
+        else hi = mid;                                                         \
+    }                                                                          \
+    return lo;                                                                 \
+}                                                                              \
+                                                                               \
+/* First position in [lo, hi) whose element key precedes. */                  \
+static int upperBound##DIR(const int arr[], int lo, int hi, int key) {         \
+    while (lo < hi) {                                                          \
+        int mid = lo + (hi - lo) / 2;                                          \
+        if (PRECEDES(key, arr[mid])) hi = mid;                                 \
+        else lo = mid + 1;                                                     \
+    }                                                                          \
+    return lo;                                                                 \
+}                                                                              \
+                                                                               \
+/* Merges the sorted runs [lo, mid) and [mid, hi) in place (see Block Merge   \
+   Sort). */                                                                  \
+static void mergeInPlace##DIR(int arr[], int lo, int mid, int hi) {            \
+    if (lo >= mid || mid >= hi) return;                                        \
+    if (!PRECEDES(arr[mid], arr[mid - 1])) return; /* Already in order */      \
+    int len1 = mid - lo, len2 = hi - mid;                                      \
+    if (len1 <= BLOCK_MERGE_BUFFER || len2 <= BLOCK_MERGE_BUFFER) {            \
+        int buf[BLOCK_MERGE_BUFFER];                                           \
+        mergeShorterRun##DIR(arr, lo, mid, hi, buf);                           \
+        return;                                                                \
+    }                                                                          \
+    int cut1, cut2;                                                            \
+    if (len1 > len2) {                                                         \
+        cut1 = lo + len1 / 2;                                                  \
+        cut2 = lowerBound##DIR(arr, mid, hi, arr[cut1]);                       \
+    } else {                                                                   \
+        cut2 = mid + len2 / 2;                                                 \
+        cut1 = upperBound##DIR(arr, lo, mid, arr[cut2]);                       \
+    }                                                                          \
+    rotateRange(arr, cut1, mid, cut2);                                         \
+    int new_mid = cut1 + (cut2 - mid);                                         \
+    mergeInPlace##DIR(arr, lo, cut1, new_mid);                                 \
+    mergeInPlace##DIR(arr, new_mid, cut2, hi);                                 \
+}                                                                              \
+                                                                               \
+/* End (exclusive) of the in-order run starting at lo. */                     \
+static int runEnd##DIR(const int arr[], int lo, int n) {                       \
+    int hi = lo + 1;                                                           \
+    while (hi < n && !PRECEDES(arr[hi], arr[hi - 1])) hi++;                    \
+    return hi;                                                                 \
+}                                                                              \
+                                                                               \
+/* Sift-down for a max-heap in this order (the root sorts last). */           \
+static void heapSiftDown##DIR(int arr[], int root, int n) {                    \
+    int key = arr[root];                                                       \
+    for (int child = 2 * root + 1; child < n; child = 2 * root + 1) {          \
+        if (child + 1 < n && PRECEDES(arr[child], arr[child + 1])) child++;    \
+        if (!PRECEDES(key, arr[child])) break;                                 \
+        arr[root] = arr[child];                                                \
+        root = child;                                                          \
+    }                                                                          \
+    arr[root] = key;                                                           \
+}                                                                              \
+                                                                               \
+static void heapSort##DIR(int arr[], int n) {                                  \
+    for (int i = n / 2 - 1; i >= 0; i--) heapSiftDown##DIR(arr, i, n);         \
+    for (int end = n - 1; end > 0; end--) {                                    \
+        swap(&arr[0], &arr[end]);                                              \
+        heapSiftDown##DIR(arr, 0, end);                                        \
+    }                                                                          \
+}
+
+DEFINE_ORDERED_KERNELS(Ascending, PRECEDES_ASCENDING)
+DEFINE_ORDERED_KERNELS(Descending, PRECEDES_DESCENDING)
+
+// --- Insertion Sort ---
+void insertionSort(int arr[], int left, int right) {
+    insertionSortOrdered(arr, left, right, SORT_ASCENDING);
+}
+
+void insertionSortOrdered(int arr[], int left, int right, SortOrder order) {
+    if (order == SORT_DESCENDING) insertionSortDescending(arr, left, right);
+    else insertionSortAscending(arr, left, right);
+}
+
+// --- Quicksort ---
+int partition(int arr[], int low, int high, SortOrder order) {
+    return order == SORT_DESCENDING ? partitionDescending(arr, low, high) : partitionAscending(arr, low, high);
+}
+
+/*
+ * The plan is made from a sample, so quicksort watches its own partitions.
+ * A large range that turns out to be one run (e.g. a sorted tail the sample
+ * missed) is returned or reversed after a linear check, a partition of at
+ * least LOCAL_ANALYSIS_MIN elements is re-analyzed on its own (see
+ * subrangeSortLocally), and once a path has made too many unbalanced
+ * splits, the rest of each side is re-planned (see quickSortReplan) instead
+ * of degrading towards O(n^2). Ranges below cutoff are insertion-sorted.
+ */
+static void quickSortAdaptive(int arr[], int low, int high, SortOrder order, int cutoff, int bad_splits_left) {
+    while (high - low + 1 >= cutoff) {
+        int m = high - low + 1;
+        if (m >= QUICKSORT_REPLAN_MIN && subrangeSingleRun(arr + low, m, order)) return;
+        if (m >= LOCAL_ANALYSIS_MIN && subrangeSortLocally(arr + low, m, order)) return;
+        int pi = partition(arr, low, high, order);
+        int smaller = (pi - low < high - pi) ? pi - low : high - pi;
+        if (m >= QUICKSORT_REPLAN_MIN && smaller < m / QUICKSORT_BAD_SPLIT && --bad_splits_left <= 0) {
+            quickSortReplan(arr, low, pi - 1, order);
+            quickSortReplan(arr, pi + 1, high, order);
+            return;
+        }
+        // Recurse into the smaller side to bound the stack depth.
+        if (pi - low < high - pi) {
+            quickSortAdaptive(arr, low, pi - 1, order, cutoff, bad_splits_left);
+            low = pi + 1;
+        } else {
+            quickSortAdaptive(arr, pi + 1, high, order, cutoff, bad_splits_left);
+            high = pi - 1;
+        }
+    }
+    if (low < high) insertionSortOrdered(arr, low, high, order);
+}
+
+void quickSortRecursive(int arr[], int low, int high, SortOrder order) {
+    quickSortWithCutoff(arr, low, high, order, smallSortCutoff());
+}
+
+// Quicksort with an explicit small-array cutoff (calibration times it with
+// none, i.e. 2, without touching the process-wide one).
+static void quickSortWithCutoff(int arr[], int low, int high, SortOrder order, int cutoff) {
+    int bad_splits = 1; // log2 of the range: random pivots rarely use them all
+    for (int m = high - low + 1; m > 1; m >>= 1) bad_splits++;
+    quickSortAdaptive(arr, low, high, order, cutoff, bad_splits);
+}
+
+void quickSort(int arr[], int low, int high) {
+    quickSortRecursive(arr, low, high, SORT_ASCENDING);
+}
+
+void quickSortOrdered(int arr[], int low, int high, SortOrder order) {
+    quickSortRecursive(arr, low, high, order);
+}
+
+
+// --- Merge Sort ---
+void merge(int arr[], int l, int m, int r, SortOrder order, int buf[]) {
+    if (order == SORT_DESCENDING) mergeDescending(arr, l, m, r, buf);
+    else mergeAscending(arr, l, m, r, buf);
+}
+
+// buf must hold ceil((r - l + 1) / 2) elements.
+void mergeSortWithBuffer(int arr[], int l, int r, SortOrder order, int buf[]) {
+    if (order == SORT_DESCENDING) mergeSortDescending(arr, l, r, buf);
+    else mergeSortAscending(arr, l, r, buf);
+}
+
+void mergeSort(int arr[], int l, int r) {
+    mergeSortOrdered(arr, l, r, SORT_ASCENDING);
+}
+
+void mergeSortOrdered(int arr[], int l, int r, SortOrder order) {
+    if (l >= r) return;
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, adaptiveHybridSortScratchSize(r - l + 1, STRATEGY_MERGESORT), false, &scratch)) {
+        blockMergeSortOrdered(arr + l, r - l + 1, order); // Failsafe: stable, in place
+        return;
+    }
+    mergeSortWithBuffer(arr, l, r, order, (int*)scratch.ptr);
+    scratchRelease(&scratch);
+}
+
+// --- Block Merge Sort (O(1) extra memory) ---
+/*
+ * Stable merge sort without an n-sized buffer. Merges whose shorter run fits
+ * in a fixed BLOCK_MERGE_BUFFER stack buffer are done directly; larger merges
+ * split both runs around a binary-searched cut, rotate the middle blocks into
+ * place and recurse, until the pieces fit the buffer. This is the rotation
+ * merge used by adaptive library merges, here with a constant-size buffer,
+ * giving O(n log^2 n) time worst case and O(1) extra memory.
+ */
+static void reverseRange(int arr[], int lo, int hi) { // [lo, hi)
+    for (hi--; lo < hi; lo++, hi--) swap(&arr[lo], &arr[hi]);
+}
+
+static void rotateRange(int arr[], int lo, int mid, int hi) {
+    reverseRange(arr, lo, mid);
+    reverseRange(arr, mid, hi);
+    reverseRange(arr, lo, hi);
+}
+
+// Stably merges the sorted runs [lo, mid) and [mid, hi), copying only the
+// shorter run into buf (min(mid - lo, hi - mid) elements).
+static void mergeShorterRun(int arr[], int lo, int mid, int hi, SortOrder order, int buf[]) {
+    if (order == SORT_DESCENDING) mergeShorterRunDescending(arr, lo, mid, hi, buf);
+    else mergeShorterRunAscending(arr, lo, mid, hi, buf);
+}
+
+// Merges the sorted runs [lo, mid) and [mid, hi) in place.
+static void mergeInPlace(int arr[], int lo, int mid, int hi, SortOrder order) {
+    if (order == SORT_DESCENDING) mergeInPlaceDescending(arr, lo, mid, hi);
+    else mergeInPlaceAscending(arr, lo, mid, hi);
+}
+
+void blockMergeSort(int arr[], int n) {
+    blockMergeSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+void blockMergeSortOrdered(int arr[], int n, SortOrder order) {
+    int cutoff = smallSortCutoff();
+    for (int lo = 0; lo < n; lo += cutoff) {
+        int hi = lo + cutoff < n ? lo + cutoff : n;
+        insertionSortOrdered(arr, lo, hi - 1, order);
+    }
+    for (int width = cutoff; width < n; width *= 2) {
+        for (int lo = 0; lo + width < n; lo += 2 * width) {
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            mergeInPlace(arr, lo, lo + width, hi, order);
+        }
+    }
+}
+
+// --- Natural Merge Sort ---
+/*
+ * Run-adaptive merges for presorted input. Strictly reversed runs are first
+ * reversed in place (which keeps equal keys stable), then existing runs are
+ * merged as found instead of being rebuilt from single elements. The natural
+ * merge repeatedly merges neighbouring runs pairwise; the k-way merge
+ * combines up to KWAY_MERGE_MAX_RUNS runs in one pass through buf with a
+ * loser tree, so the data is read and written twice instead of once per
+ * merge level.
+ */
+
+// End (exclusive) of the in-order run starting at lo.
+static int runEnd(const int arr[], int lo, int n, SortOrder order) {
+    return order == SORT_DESCENDING ? runEndDescending(arr, lo, n) : runEndAscending(arr, lo, n);
+}
+
+// Reverses every strictly reversed run so all runs are in order.
+static void reverseDescendingRuns(int arr[], int n, SortOrder order) {
+    int lo = 0;
+    while (lo < n) {
+        int hi = lo + 1;
+        if (hi < n && KEY_PRECEDES(arr[hi], arr[lo], order)) {
+            while (hi < n && KEY_PRECEDES(arr[hi], arr[hi - 1], order)) hi++;
+            reverseRange(arr, lo, hi);
+        } else {
+            hi = runEnd(arr, lo, n, order);
+        }
+        lo = hi;
+    }
+}
+
+// buf must hold n / 2 elements, or be NULL to merge the runs in place.
+void naturalMergeSortWithBuffer(int arr[], int n, SortOrder order, int buf[]) {
+    reverseDescendingRuns(arr, n, order);
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        int lo = 0;
+        while (lo < n) {
+            int mid = runEnd(arr, lo, n, order);
+            if (mid == n) break;
+            int hi = runEnd(arr, mid, n, order);
+            if (buf) mergeShorterRun(arr, lo, mid, hi, order, buf);
+            else mergeInPlace(arr, lo, mid, hi, order);
+            merged = true;
+            lo = hi;
+        }
+    }
+}
+
+// Loser tree over the k-way merge's run heads: node i holds the run that
+// lost the match played there and tree[0] the overall winner. Exhausted runs
+// lose every match; ties go to the earlier run so the merge is stable. For a
+// descending sort the keys are stored complemented (~x reverses the order of
+// ints), so the matches always compare ascending.
+typedef struct {
+    int key[KWAY_MERGE_MAX_RUNS];
+    bool done[KWAY_MERGE_MAX_RUNS];
+    int tree[KWAY_MERGE_MAX_RUNS];
+    int leaves; // Power of two >= number of runs
+} RunTree;
+
+static inline bool runBeats(const RunTree* t, int a, int b) {
+    if (t->done[a] || t->done[b]) return !t->done[a] && (t->done[b] || a < b);
+    if (t->key[a] < t->key[b]) return true;
+    return a < b && t->key[b] >= t->key[a];
+}
+
+static int runTreeBuild(RunTree* t, int node) {
+    if (node >= t->leaves) return node - t->leaves;
+    int a = runTreeBuild(t, 2 * node);
+    int b = runTreeBuild(t, 2 * node + 1);
+    bool a_wins = runBeats(t, a, b);
+    t->tree[node] = a_wins ? b : a;
+    return a_wins ? a : b;
+}
+
+// Replays the matches on the path of run w after its head changed.
+static void runTreeReplay(RunTree* t, int w) {
+    for (int node = (w + t->leaves) / 2; node >= 1; node /= 2) {
+        if (runBeats(t, t->tree[node], w)) {
+            int loser = w;
+            w = t->tree[node];
+            t->tree[node] = loser;
+        }
+    }
+    t->tree[0] = w;
+}
+
+// buf must hold n elements. Falls back to the natural merge when the input
+// has more than KWAY_MERGE_MAX_RUNS runs.
+void kWayMergeSortWithBuffer(int arr[], int n, SortOrder order, int buf[]) {
+    reverseDescendingRuns(arr, n, order);
+    int next[KWAY_MERGE_MAX_RUNS], end[KWAY_MERGE_MAX_RUNS];
+    RunTree t;
+    int flip = order == SORT_DESCENDING ? ~0 : 0; // Complements the keys of a descending sort
+    int runs = 0;
+    for (int lo = 0; lo < n; lo = end[runs++]) {
+        if (runs == KWAY_MERGE_MAX_RUNS) {
+            naturalMergeSortWithBuffer(arr, n, order, buf);
+            return;
+        }
+        end[runs] = runEnd(arr, lo, n, order);
+        next[runs] = lo + 1;
+        t.key[runs] = arr[lo] ^ flip;
+        t.done[runs] = false;
+    }
+    if (runs <= 1) return;
+
+    for (t.leaves = 1; t.leaves < runs; t.leaves *= 2) {}
+    for (int r = runs; r < t.leaves; r++) t.done[r] = true;
+    t.tree[0] = runTreeBuild(&t, 1);
+    for (int k = 0; k < n; k++) {
+        int r = t.tree[0];
+        buf[k] = t.key[r] ^ flip;
+        if (next[r] < end[r]) t.key[r] = arr[next[r]++] ^ flip;
+        else t.done[r] = true;
+        runTreeReplay(&t, r);
+    }
+    memcpy(arr, buf, (size_t)n * sizeof(int));
+}
+
+void naturalMergeSort(int arr[], int n) {
+    naturalMergeSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+void naturalMergeSortOrdered(int arr[], int n, SortOrder order) {
+    if (n <= 1) return;
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, adaptiveHybridSortScratchSize(n, STRATEGY_NATURAL_MERGE), false, &scratch)) {
+        blockMergeSortOrdered(arr, n, order); // Failsafe: stable, in place
+        return;
+    }
+    naturalMergeSortWithBuffer(arr, n, order, (int*)scratch.ptr);
+    scratchRelease(&scratch);
+}
+
+// --- Radix Sort ---
+/*
+ * Generates a byte-wise LSD radix sort for element type T with KEY_BYTES key
+ * bytes. BYTE_AT(x, b) must yield byte b (0 = least significant) of an
+ * order-preserving unsigned encoding of x. Bytes that are identical in all
+ * keys (e.g. the high bytes of timestamps from one day, or of ids in a dense
+ * range) get no scatter pass. Keys narrower than RADIX_PREPASS_KEY_BYTES
+ * find them in the single histogram pass: a byte is constant when the first
+ * key's bucket holds all n. Wider keys first OR and AND every key byte (a
+ * byte whose OR equals its AND is constant) and then build histograms of
+ * the varying bytes only, since skipping most of 16 histograms saves more
+ * than the extra read costs. Descending order inverts every digit, i.e. the
+ * key transform itself.
+ * Passes ping-pong between arr and buf (n elements); the function returns the
+ * buffer that holds the sorted output and never copies back.
+ *
+ * Large scatters go through software write-combining: each bucket collects
+ * elements in a cache-line-sized staging buffer and full lines are flushed
+ * to the output at once, so the random writes touch one line per flush
+ * instead of one per element. A bucket's first line is shortened to end on a
+ * line boundary, which keeps the later flushes aligned so they can use
+ * streaming stores that bypass the cache. Staging only pays off together
+ * with streaming stores on arrays larger than the last-level cache (with
+ * plain stores it measured slower than the direct scatter), so it is used
+ * only when both hold.
+ */
+static inline void radixFlushLine(void* dst, const void* line, size_t bytes) {
+#if RADIX_WC_STREAMING
+    if (bytes == RADIX_WC_LINE_BYTES && ((uintptr_t)dst % RADIX_WC_LINE_BYTES) == 0) {
+        for (size_t j = 0; j < RADIX_WC_LINE_BYTES / 16; j++) {
+            _mm_stream_si128((__m128i*)dst + j, _mm_load_si128((const __m128i*)line + j));
+        }
+        return;
+    }
+#endif
+    memcpy(dst, line, bytes);
+}
+
+static inline void radixStoreFence(void) {
+#if RADIX_WC_STREAMING
+    _mm_sfence(); // Order streaming stores before the next pass reads them
+#endif
+}
+
+#define RADIX_WC_ELEMS(T) (RADIX_WC_LINE_BYTES / sizeof(T) > 0 ? RADIX_WC_LINE_BYTES / sizeof(T) : 1)
+
+#define DEFINE_LSD_RADIX_SORT(NAME, T, KEY_BYTES, BYTE_AT)                      \
+T* NAME(T arr[], size_t n, SortOrder order, T buf[]) {                         \
+    const unsigned flip = (order == SORT_DESCENDING) ? 0xFF : 0x00;            \
+    if (n <= 1) return arr;                                                    \
+                                                                               \
+    int digits[(KEY_BYTES)];                                                   \
+    int num_digits = 0;                                                        \
+    size_t count[(KEY_BYTES)][RADIX_BUCKETS];                                  \
+    if ((KEY_BYTES) < RADIX_PREPASS_KEY_BYTES) {                               \
+        memset(count, 0, sizeof(count));                                       \
+        for (size_t i = 0; i < n; i++) {                                       \
+            for (int b = 0; b < (KEY_BYTES); b++) {                            \
+                count[b][BYTE_AT(arr[i], b) ^ flip]++;                         \
+            }                                                                  \
+        }                                                                      \
+        for (int b = 0; b < (KEY_BYTES); b++) {                                \
+            if (count[b][BYTE_AT(arr[0], b) ^ flip] == n) continue;            \
+            if (num_digits != b) {                                             \
+                memcpy(count[num_digits], count[b], sizeof(count[0]));        \
+            }                                                                  \
+            digits[num_digits++] = b;                                          \
+        }                                                                      \
+    } else {                                                                   \
+        unsigned all_or[(KEY_BYTES)], all_and[(KEY_BYTES)];                    \
+        for (int b = 0; b < (KEY_BYTES); b++) {                                \
+            all_or[b] = 0x00;                                                  \
+            all_and[b] = 0xFF;                                                 \
+        }                                                                      \
+        for (size_t i = 0; i < n; i++) {                                       \
+            for (int b = 0; b < (KEY_BYTES); b++) {                            \
+                unsigned d = BYTE_AT(arr[i], b);                               \
+                all_or[b] |= d;                                                \
+                all_and[b] &= d;                                               \
+            }                                                                  \
+        }                                                                      \
+        for (int b = 0; b < (KEY_BYTES); b++) {                                \
+            if (all_or[b] != all_and[b]) digits[num_digits++] = b;             \
+        }                                                                      \
+        memset(count, 0, num_digits * sizeof(count[0]));                       \
+        for (size_t i = 0; i < n; i++) {                                       \
+            for (int k = 0; k < num_digits; k++) {                             \
+                count[k][BYTE_AT(arr[i], digits[k]) ^ flip]++;                 \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+    if (num_digits == 0) return arr; /* All keys are equal */                  \
+    const size_t wc_elems = RADIX_WC_ELEMS(T);                                 \
+    const bool use_wc = RADIX_WC_STREAMING && wc_elems >= 2 &&                 \
+                        n >= RADIX_WC_MIN_BYTES / sizeof(T) &&                 \
+                        RADIX_WC_LINE_BYTES % sizeof(T) == 0;                  \
+    _Alignas(RADIX_WC_LINE_BYTES) T stage[RADIX_BUCKETS][RADIX_WC_ELEMS(T)];   \
+    T* src = arr;                                                              \
+    T* dst = buf;                                                              \
+    for (int k = 0; k < num_digits; k++) {                                     \
+        int b = digits[k];                                                     \
+        size_t sum = 0;                                                        \
+        for (int d = 0; d < RADIX_BUCKETS; d++) {                              \
+            size_t c = count[k][d];                                            \
+            count[k][d] = sum;                                                 \
+            sum += c;                                                          \
+        }                                                                      \
+        if (!use_wc) {                                                         \
+            for (size_t i = 0; i < n; i++) {                                   \
+                dst[count[k][BYTE_AT(src[i], b) ^ flip]++] = src[i];           \
+            }                                                                  \
+        } else {                                                               \
+            size_t fill[RADIX_BUCKETS], cap[RADIX_BUCKETS];                    \
+            for (int d = 0; d < RADIX_BUCKETS; d++) {                          \
+                fill[d] = 0;                                                   \
+                cap[d] = wc_elems - ((uintptr_t)(dst + count[k][d]) %          \
+                                     RADIX_WC_LINE_BYTES) / sizeof(T);         \
+            }                                                                  \
+            for (size_t i = 0; i < n; i++) {                                   \
+                unsigned d = BYTE_AT(src[i], b) ^ flip;                        \
+                stage[d][fill[d]++] = src[i];                                  \
+                if (fill[d] == cap[d]) {                                       \
+                    radixFlushLine(dst + count[k][d], stage[d], fill[d] * sizeof(T)); \
+                    count[k][d] += fill[d];                                    \
+                    fill[d] = 0;                                               \
+                    cap[d] = wc_elems;                                         \
+                }                                                              \
+            }                                                                  \
+            for (int d = 0; d < RADIX_BUCKETS; d++) {                          \
+                if (fill[d]) memcpy(dst + count[k][d], stage[d], fill[d] * sizeof(T)); \
+            }                                                                  \
+            radixStoreFence();                                                 \
+        }                                                                      \
+        T* t = src;                                                            \
+        src = dst;                                                             \
+        dst = t;                                                               \
+    }                                                                          \
+    return src;                                                                \
+}
+
+// Signed keys flip their sign bit so that two's complement orders as unsigned.
+#define BYTE_I32(x, b) ((uint8_t)(((uint32_t)(x) ^ UINT32_C(0x80000000)) >> (8 * (b))))
+
+static DEFINE_LSD_RADIX_SORT(radixSortI32InBuffers, int, 4, BYTE_I32)
+
+/**
+ * @brief Radix sorts by ping-ponging between arr and buf (n elements each).
+ * @return The buffer holding the sorted output (arr or buf); nothing is
+ *         copied back, for callers that can consume the result in place.
+ */
+int* radixSortInBuffers(int arr[], int n, SortOrder order, int buf[]) {
+    return radixSortI32InBuffers(arr, (size_t)n, order, buf);
+}
+
+// buf must hold n elements. One final copy is made only for odd pass counts.
+void radixSortWithBuffer(int arr[], int n, SortOrder order, int buf[]) {
+    int* sorted = radixSortInBuffers(arr, n, order, buf);
+    if (sorted != arr) memcpy(arr, sorted, n * sizeof(int));
+}
+
+void radixSort(int arr[], int n) {
+    radixSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortOrdered(int arr[], int n, SortOrder order) {
+    if (n <= 1) return;
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, adaptiveHybridSortScratchSize(n, STRATEGY_RADIXSORT), false, &scratch)) {
+        msdRadixSortOrdered(arr, n, order); // Failsafe: sort in place
+        return;
+    }
+    radixSortWithBuffer(arr, n, order, (int*)scratch.ptr);
+    scratchRelease(&scratch);
+}
+
+// --- In-Place MSD Radix Sort (American Flag Sort) ---
+/*
+ * Byte-wise MSD radix sort that needs no n-sized buffer: bucket offsets are
+ * computed from a histogram and elements are permuted into their buckets by
+ * cycle-walking, then every bucket is sorted recursively on the next byte.
+ * Small buckets are finished with Insertion Sort. Extra memory is a few
+ * bucket tables on the stack per level (at most four levels for int keys).
+ */
+static inline unsigned msdDigit(int x, int shift, SortOrder order) {
+    unsigned d = (((uint32_t)x ^ UINT32_C(0x80000000)) >> shift) & 0xFF; // Sign flip
+    return (order == SORT_DESCENDING) ? d ^ 0xFF : d;
+}
+
+static void msdRadixSortRecursive(int arr[], int n, int shift, SortOrder order) {
+    if (n < MSD_RADIX_CUTOFF) {
+        insertionSortOrdered(arr, 0, n - 1, order);
+        return;
+    }
+
+    int count[RADIX_BUCKETS] = {0};
+    for (int i = 0; i < n; i++) count[msdDigit(arr[i], shift, order)]++;
+
+    // Skip a byte that is identical for the whole range.
+    if (count[msdDigit(arr[0], shift, order)] == n) {
+        if (shift > 0) msdRadixSortRecursive(arr, n, shift - 8, order);
+        return;
+    }
+
+    int head[RADIX_BUCKETS], tail[RADIX_BUCKETS];
+    int sum = 0;
+    for (int d = 0; d < RADIX_BUCKETS; d++) {
+        head[d] = sum;
+        sum += count[d];
+        tail[d] = sum;
+    }
+
+    // Cycle-walk: carry each misplaced element to the next free slot of its bucket.
+    for (int d = 0; d < RADIX_BUCKETS; d++) {
+        while (head[d] < tail[d]) {
+            int v = arr[head[d]];
+            unsigned vd = msdDigit(v, shift, order);
+            while (vd != (unsigned)d) {
+                int t = arr[head[vd]];
+                arr[head[vd]++] = v;
+                v = t;
+                vd = msdDigit(v, shift, order);
+            }
+            arr[head[d]++] = v;
+        }
+    }
+
+    if (shift == 0) return;
+    int start = 0;
+    for (int d = 0; d < RADIX_BUCKETS; d++) {
+        // A large bucket may be ordered or narrow enough to finish at once.
+        int* bucket = arr + start;
+        bool done = count[d] >= LOCAL_ANALYSIS_MIN && (subrangeSingleRun(bucket, count[d], order) ||
+                                                        subrangeSortLocally(bucket, count[d], order));
+        if (!done && count[d] > 1) msdRadixSortRecursive(bucket, count[d], shift - 8, order);
+        start += count[d];
+    }
+}
+
+void msdRadixSort(int arr[], int n) {
+    msdRadixSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+void msdRadixSortOrdered(int arr[], int n, SortOrder order) {
+    if (n > 1) msdRadixSortRecursive(arr, n, 24, order);
+}
+
+// --- Counting Sort ---
+/*
+ * For keys within a narrow range (bytes, enums, small ids, ages): one
+ * histogram pass and a write-out, O(n + range). Consecutive equal keys would
+ * make every increment wait for the previous store to the same counter, so
+ * the histogram is split into COUNTING_SORT_LANES interleaved copies that
+ * are summed afterwards. The key-only sort rewrites each key count times;
+ * the key+value sort turns the counts into output offsets and scatters the
+ * pairs stably. The exact range comes from a min/max pass over the keys.
+ */
+
+// Widest key range the adaptive sort counts for n keys: the lanes together
+// hold at most n counters, the same scratch as the LSD radix buffer.
+static size_t countingSortMaxRange(int n) {
+    size_t range = (size_t)n / COUNTING_SORT_LANES;
+    return range < COUNTING_SORT_MAX_RANGE ? range : COUNTING_SORT_MAX_RANGE;
+}
+
+static void keyMinMax(const int keys[], int n, int* min, int* max) {
+    int lo = keys[0], hi = keys[0];
+    for (int i = 1; i < n; i++) {
+        lo = keys[i] < lo ? keys[i] : lo;
+        hi = keys[i] > hi ? keys[i] : hi;
+    }
+    *min = lo;
+    *max = hi;
+}
+
+// Counts keys - min into counts[0, range); counts must hold
+// COUNTING_SORT_LANES * range entries.
+static void countingHistogram(const int keys[], int n, int min, size_t range, uint32_t counts[]) {
+    memset(counts, 0, COUNTING_SORT_LANES * range * sizeof(uint32_t));
+    int i = 0;
+    for (; i + COUNTING_SORT_LANES <= n; i += COUNTING_SORT_LANES) {
+        for (int lane = 0; lane < COUNTING_SORT_LANES; lane++) {
+            counts[lane * range + (uint32_t)(keys[i + lane] - min)]++;
+        }
+    }
+    for (; i < n; i++) counts[(uint32_t)(keys[i] - min)]++;
+    for (int lane = 1; lane < COUNTING_SORT_LANES; lane++) {
+        for (size_t v = 0; v < range; v++) counts[v] += counts[lane * range + v];
+    }
+}
+
+// counts must hold capacity entries. Returns false, leaving arr untouched,
+// if the key range needs more than capacity / COUNTING_SORT_LANES counters.
+bool countingSortWithBuffer(int arr[], int n, SortOrder order, uint32_t counts[], size_t capacity) {
+    if (n <= 1) return true;
+    int min, max;
+    keyMinMax(arr, n, &min, &max);
+    size_t range = (size_t)((long long)max - min) + 1;
+    if (range > capacity / COUNTING_SORT_LANES) return false;
+
+    countingHistogram(arr, n, min, range, counts);
+    int k = 0;
+    for (size_t i = 0; i < range; i++) {
+        size_t v = (order == SORT_DESCENDING) ? range - 1 - i : i;
+        int key = (int)((long long)min + (long long)v);
+        for (uint32_t c = counts[v]; c > 0; c--) arr[k++] = key;
+    }
+    return true;
+}
+
+void countingSort(int arr[], int n) {
+    countingSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+// Falls back to the in-place MSD radix sort when the keys span more than
+// COUNTING_SORT_MAX_RANGE values or the counters cannot be allocated.
+void countingSortOrdered(int arr[], int n, SortOrder order) {
+    if (n <= 1) return;
+    ScratchBlock scratch;
+    size_t bytes = (size_t)COUNTING_SORT_LANES * COUNTING_SORT_MAX_RANGE * sizeof(uint32_t);
+    if (!scratchAcquire(NULL, bytes, false, &scratch)) {
+        msdRadixSortOrdered(arr, n, order); // Failsafe: sort in place
+        return;
+    }
+    if (!countingSortWithBuffer(arr, n, order, (uint32_t*)scratch.ptr, bytes / sizeof(uint32_t))) {
+        msdRadixSortOrdered(arr, n, order);
+    }
+    scratchRelease(&scratch);
+}
+
+/**
+ * @brief Stably sorts keys and reorders values alongside them (e.g. row ids).
+ * @param keys The keys, spanning at most COUNTING_SORT_MAX_RANGE values.
+ * @param values Payload moved with its key.
+ * @param n The number of pairs.
+ * @param order SORT_ASCENDING or SORT_DESCENDING.
+ * @return false, with both arrays unchanged, if the key range is too wide or
+ *         the scratch memory (2n ints plus the counters) is unavailable.
+ */
+bool countingSortKeyValue(int keys[], int values[], int n, SortOrder order) {
+    if (n <= 1) return true;
+    int min, max;
+    keyMinMax(keys, n, &min, &max);
+    size_t range = (size_t)((long long)max - min) + 1;
+    if (range > COUNTING_SORT_MAX_RANGE) return false;
+
+    ScratchBlock scratch;
+    size_t count_bytes = COUNTING_SORT_LANES * range * sizeof(uint32_t);
+    if (!scratchAcquire(NULL, count_bytes + 2 * (size_t)n * sizeof(int), false, &scratch)) {
+        return false;
+    }
+    uint32_t* counts = (uint32_t*)scratch.ptr;
+    int* key_copy = (int*)((char*)scratch.ptr + count_bytes);
+    int* value_copy = key_copy + n;
+    memcpy(key_copy, keys, (size_t)n * sizeof(int));
+    memcpy(value_copy, values, (size_t)n * sizeof(int));
+
+    countingHistogram(keys, n, min, range, counts);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < range; i++) { // Counts become output offsets
+        size_t v = (order == SORT_DESCENDING) ? range - 1 - i : i;
+        uint32_t c = counts[v];
+        counts[v] = offset;
+        offset += c;
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t pos = counts[(uint32_t)(key_copy[i] - min)]++;
+        keys[pos] = key_copy[i];
+        values[pos] = value_copy[i];
+    }
+    scratchRelease(&scratch);
+    return true;
+}
+
+// --- Subrange Re-analysis and Quicksort Re-planning ---
+/*
+ * The global analysis makes one decision from a sample, but data is often
+ * a mix of sorted segments, narrow-range clusters and random regions. The
+ * engines that split the input (quicksort partitions, MSD radix buckets)
+ * therefore look at each large piece again, in place and with stack memory
+ * only: a piece that is one run is finished by a linear check, a piece whose
+ * sampled key range is narrow is counted, and a piece of a few runs is
+ * merged naturally. Anything else stays with the engine that produced it.
+ *
+ * When quicksort keeps splitting a range badly, the sample that chose it was
+ * wrong about that range. Each side is then re-planned more thoroughly: a
+ * narrow key range is counted (exact range, no sample), a range that is
+ * mostly one sorted run at either end sorts only the rest and merges it in,
+ * a range of a few runs is merged naturally, and anything else is heap
+ * sorted, which is O(m log m) whatever the order.
+ */
+
+// Finishes arr if it is one run: in order already, or strictly reversed.
+static bool subrangeSingleRun(int arr[], int n, SortOrder order) {
+    int direction = presortedDirection(arr, n, order);
+    if (direction < 0) reverseRange(arr, 0, n);
+    return direction != 0;
+}
+
+static void heapSortOrdered(int arr[], int n, SortOrder order) {
+    if (order == SORT_DESCENDING) heapSortDescending(arr, n);
+    else heapSortAscending(arr, n);
+}
+
+// Runs (in order or strictly reversed) in arr, counting at most limit + 1.
+static int countRunsUpTo(const int arr[], int n, SortOrder order, int limit) {
+    int runs = 0, lo = 0;
+    while (lo < n && runs <= limit) {
+        int hi = lo + 1;
+        if (hi < n && KEY_PRECEDES(arr[hi], arr[lo], order)) {
+            while (hi < n && KEY_PRECEDES(arr[hi], arr[hi - 1], order)) hi++;
+        } else {
+            hi = runEnd(arr, lo, n, order);
+        }
+        runs++;
+        lo = hi;
+    }
+    return runs;
+}
+
+// Counting sort of a subrange with LOCAL_SORT_COUNTERS counters on the stack.
+// Kept out of line: inlined, the 16KB of counters would stay in the frame of
+// the recursive quicksort that calls it.
+static NOINLINE bool countingSortLocal(int arr[], int n, SortOrder order) {
+    uint32_t counts[LOCAL_SORT_COUNTERS];
+    return countingSortWithBuffer(arr, n, order, counts, LOCAL_SORT_COUNTERS);
+}
+
+// Sorts arr with a better engine if a cheap local analysis finds one; false
+// leaves arr untouched. Expects arr not to be a single run.
+static bool subrangeSortLocally(int arr[], int n, SortOrder order) {
+    int lo = arr[0], hi = arr[0];
+    for (int k = 1; k < LOCAL_SAMPLE_SIZE; k++) {
+        int x = arr[(long long)k * n / LOCAL_SAMPLE_SIZE];
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+    }
+    long long sampled_range = (long long)hi - lo + 1;
+    if (sampled_range <= n / 2 && sampled_range <= LOCAL_SORT_COUNTERS / COUNTING_SORT_LANES / 2) {
+        if (countingSortLocal(arr, n, order)) return true;
+    }
+    if (countRunsUpTo(arr, n, order, KWAY_MERGE_MAX_RUNS) <= KWAY_MERGE_MAX_RUNS) {
+        naturalMergeSortWithBuffer(arr, n, order, NULL);
+        return true;
+    }
+    return false;
+}
+
+static void quickSortReplan(int arr[], int low, int high, SortOrder order) {
+    int m = high - low + 1;
+    if (m < QUICKSORT_REPLAN_MIN) {
+        quickSortAdaptive(arr, low, high, order, smallSortCutoff(), 1);
+        return;
+    }
+    int* a = arr + low;
+
+    if (countingSortLocal(a, m, order)) return;
+
+    int head = runEnd(a, 0, m, order);
+    int tail = m - 1;
+    while (tail > 0 && !KEY_PRECEDES(a[tail], a[tail - 1], order)) tail--;
+    if (head >= m / 2) {
+        quickSortRecursive(a, head, m - 1, order);
+        mergeInPlace(a, 0, head, m, order);
+    } else if (m - tail >= m / 2) {
+        quickSortRecursive(a, 0, tail - 1, order);
+        mergeInPlace(a, 0, tail, m, order);
+    } else if (countRunsUpTo(a, m, order, KWAY_MERGE_MAX_RUNS) <= KWAY_MERGE_MAX_RUNS) {
+        naturalMergeSortWithBuffer(a, m, order, NULL);
+    } else {
+        heapSortOrdered(a, m, order);
+    }
+}
+
+// --- Chunked Adaptive Sort ---
+/*
+ * Large inputs are rarely uniform: time-partitioned data is a sequence of
+ * blocks that are each sorted, reversed, narrow or random on their own. The
+ * chunked sort splits the input into chunks of at most
+ * CHUNKED_SORT_CHUNK_BYTES, so each chunk is sorted within L2, and runs the
+ * full decision on every chunk: a chunk that is already one run costs a
+ * scan, a narrow one is counted, a random one goes to the cheapest engine.
+ * The chunks are sorted on up to sortThreads() threads and combined by
+ * pairwise merge passes that ping-pong between arr and buf. Each pass is
+ * split by merge path: worker w writes output positions [w n/W, (w+1) n/W)
+ * and finds where its inputs start with one binary search per run pair, so
+ * every worker merges the same number of elements whatever the data. When
+ * every chunk boundary is already in order (disjoint, ordered partitions)
+ * the merge is skipped.
+ *
+ * The workers are started once per call and step through the phases
+ * together, separated by a barrier. Starting a thread allocates its stack,
+ * so the planner only considers this engine for calls that may allocate
+ * (no caller workspace), and the threads started are counted in the call's
+ * SortMemoryStats.
+ */
+typedef struct {
+    int* arr;
+    int* buf;
+    int n;
+    int chunk;
+    SortOrder order;
+    int workers; // Threads taking part, the caller included
+#if defined(__linux__)
+    pthread_barrier_t barrier;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    bool started;
+#endif
+} ChunkedSort;
+
+typedef struct {
+    ChunkedSort* sort;
+    int index;
+} ChunkedWorker;
+
+static int chunkedSortChunkLength(int n, int threads) {
+    int per_thread = (int)(((long long)n + threads - 1) / threads);
+    int chunk = (int)(CHUNKED_SORT_CHUNK_BYTES / sizeof(int));
+    if (per_thread < chunk) chunk = per_thread; // Every thread gets a chunk
+    return chunk > CHUNKED_SORT_MIN_CHUNK ? chunk : CHUNKED_SORT_MIN_CHUNK;
+}
+
+// Sorts one chunk with the engine the decision picks for it; buf must hold
+// n elements, which every engine's scratch fits in.
+static void chunkSortAdaptive(int arr[], int n, SortOrder order, int buf[]) {
+    SortOptions options = {0};
+    options.order = order;
+    options.limit_memory = true;
+    options.max_extra_bytes = (size_t)n * sizeof(int);
+    SortExplanation plan;
+    bool reused;
+    sortDecide(arr, n, &options, &plan, NULL, &reused);
+    if (plan.reason == SORT_REASON_REVERSED) reverseRange(arr, 0, n);
+    if (plan.reason == SORT_REASON_ALREADY_SORTED || plan.reason == SORT_REASON_REVERSED) return;
+    runStrategy(arr, n, order, plan.strategy, buf, options.max_extra_bytes);
+}
+
+// Writes output positions [lo, hi) of one pass that merges neighbouring runs
+// of width elements from src into dst. The direction is dispatched once per
+// pair of runs; the split search and the merge are per-direction kernels.
+static void chunkedMergeSlice(const int src[], int dst[], int n, long long width, int lo, int hi,
+                              SortOrder order) {
+    bool descending = order == SORT_DESCENDING;
+    long long pair = 2 * width;
+    for (long long p = lo / pair * pair; p < hi; p += pair) {
+        int la = (int)(n - p < width ? n - p : width);
+        int lb = (int)(n - p - la < width ? n - p - la : width);
+        const int* a = src + p;
+        const int* b = a + la;
+        int k0 = (int)((lo > p ? lo : p) - p);
+        int k1 = (int)((hi < p + la + lb ? hi : p + la + lb) - p);
+        if (descending) {
+            int i0 = mergePathSplitDescending(a, la, b, lb, k0);
+            int i1 = mergePathSplitDescending(a, la, b, lb, k1);
+            mergeIntoDescending(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), dst + p + k0);
+        } else {
+            int i0 = mergePathSplitAscending(a, la, b, lb, k0);
+            int i1 = mergePathSplitAscending(a, la, b, lb, k1);
+            mergeIntoAscending(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), dst + p + k0);
+        }
+    }
+}
+
+static void chunkedSortBarrier(ChunkedSort* cs) {
+#if defined(__linux__)
+    if (cs->workers > 1) pthread_barrier_wait(&cs->barrier);
+#else
+    (void)cs;
+#endif
+}
+
+// One worker's share of every phase: chunks index, index + W, ..., then its
+// slice of each merge pass and of the final copy back into arr.
+static void chunkedSortWork(ChunkedSort* cs, int index) {
+    int n = cs->n, chunk = cs->chunk, workers = cs->workers;
+    for (long long lo = (long long)index * chunk; lo < n; lo += (long long)workers * chunk) {
+        int len = (int)(n - lo < chunk ? n - lo : chunk);
+        chunkSortAdaptive(cs->arr + lo, len, cs->order, cs->buf + lo);
+    }
+    chunkedSortBarrier(cs);
+
+    bool ordered = true;
+    for (long long lo = chunk; ordered && lo < n; lo += chunk) {
+        ordered = !KEY_PRECEDES(cs->arr[lo], cs->arr[lo - 1], cs->order);
+    }
+    if (ordered) return;
+
+    int lo = (int)((long long)n * index / workers);
+    int hi = (int)((long long)n * (index + 1) / workers);
+    int* src = cs->arr;
+    int* dst = cs->buf;
+    for (long long width = chunk; width < n; width *= 2) {
+        chunkedMergeSlice(src, dst, n, width, lo, hi, cs->order);
+        chunkedSortBarrier(cs);
+        int* swap_buf = src;
+        src = dst;
+        dst = swap_buf;
+    }
+    if (src != cs->arr) memcpy(cs->arr + lo, src + lo, (size_t)(hi - lo) * sizeof(int));
+}
+
+#if defined(__linux__)
+static void* chunkedSortWorker(void* arg) {
+    ChunkedWorker* worker = (ChunkedWorker*)arg;
+    ChunkedSort* cs = worker->sort;
+    pthread_mutex_lock(&cs->lock);
+    while (!cs->started) pthread_cond_wait(&cs->start, &cs->lock);
+    pthread_mutex_unlock(&cs->lock);
+    if (worker->index < cs->workers) chunkedSortWork(cs, worker->index);
+    return NULL;
+}
+#endif
+
+// buf must hold n elements.
+void chunkedSortWithBuffer(int arr[], int n, SortOrder order, int buf[]) {
+    if (n <= 1 || subrangeSingleRun(arr, n, order)) return;
+    int threads = sortThreads();
+    ChunkedSort cs = {.arr = arr, .buf = buf, .n = n, .order = order, .workers = 1};
+    cs.chunk = chunkedSortChunkLength(n, threads);
+    int chunks = (int)(((long long)n + cs.chunk - 1) / cs.chunk);
+    if (threads > chunks) threads = chunks;
+
+#if defined(__linux__)
+    // The workers wait until the caller knows how many of them started;
+    // if the barrier cannot be set up they return and the caller works alone.
+    pthread_t handles[CHUNKED_SORT_MAX_THREADS];
+    ChunkedWorker workers[CHUNKED_SORT_MAX_THREADS];
+    int started = 0;
+    pthread_mutex_init(&cs.lock, NULL);
+    pthread_cond_init(&cs.start, NULL);
+    cs.started = false;
+    for (int t = 1; t < threads; t++) {
+        workers[started] = (ChunkedWorker){.sort = &cs, .index = started + 1};
+        if (pthread_create(&handles[started], NULL, chunkedSortWorker, &workers[started]) == 0) started++;
+    }
+    if (started > 0 && pthread_barrier_init(&cs.barrier, NULL, (unsigned)(started + 1)) == 0) {
+        cs.workers = started + 1;
+    }
+    pthread_mutex_lock(&cs.lock);
+    cs.started = true;
+    pthread_cond_broadcast(&cs.start);
+    pthread_mutex_unlock(&cs.lock);
+    chunkedSortWork(&cs, 0);
+    for (int t = 0; t < started; t++) pthread_join(handles[t], NULL);
+    if (cs.workers > 1) pthread_barrier_destroy(&cs.barrier);
+    pthread_cond_destroy(&cs.start);
+    pthread_mutex_destroy(&cs.lock);
+    sort_stats.allocations += (unsigned long long)started; // Each thread maps a stack
+    sort_stats.threads_started += (unsigned long long)started;
+#else
+    chunkedSortWork(&cs, 0);
+#endif
+}
+
+void chunkedSort(int arr[], int n) {
+    chunkedSortOrdered(arr, n, SORT_ASCENDING);
+}
+
+void chunkedSortOrdered(int arr[], int n, SortOrder order) {
+    if (n <= 1) return;
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, adaptiveHybridSortScratchSize(n, STRATEGY_CHUNKED), false, &scratch)) {
+        quickSortOrdered(arr, 0, n - 1, order); // Failsafe: in place
+        return;
+    }
+    chunkedSortWithBuffer(arr, n, order, (int*)scratch.ptr);
+    scratchRelease(&scratch);
+}
+
+// --- Wide-Key Radix Sort ---
+// Key transforms for the wide types; signed keys flip the sign bit as above.
+#define BYTE_U64(x, b) ((uint8_t)((x) >> (8 * (b))))
+#define BYTE_I64(x, b) ((uint8_t)(((uint64_t)(x) ^ UINT64_C(0x8000000000000000)) >> (8 * (b))))
+#define BYTE_KEY128(x, b) \
+    ((uint8_t)((b) < 8 ? (x).lo >> (8 * (b)) : (x).hi >> (8 * ((b) - 8))))
+
+DEFINE_LSD_RADIX_SORT(radixSortU64InBuffers, uint64_t, 8, BYTE_U64)
+DEFINE_LSD_RADIX_SORT(radixSortI64InBuffers, int64_t, 8, BYTE_I64)
+DEFINE_LSD_RADIX_SORT(radixSortKey128InBuffers, SortKey128, 16, BYTE_KEY128)
+
+// Failsafe when the radix scratch cannot be allocated: comparison sort, then
+// reverse for descending order.
+static void qsortOrdered(void* base, size_t n, size_t size,
+                         int (*compare)(const void*, const void*), SortOrder order) {
+    qsort(base, n, size, compare);
+    if (order == SORT_DESCENDING) reverseElements(base, n, size);
+}
+
+// Sorts arr with IN_BUFFERS on scratch from the thread cache, copying the
+// result back only when the pass count was odd.
+#define RUN_WIDE_RADIX(IN_BUFFERS, T, COMPARE, arr, n, order)                  \
+    do {                                                                       \
+        ScratchBlock scratch;                                                  \
+        if ((n) <= 1) break;                                                   \
+        if (!scratchAcquire(NULL, (n) * sizeof(T), false, &scratch)) {         \
+            qsortOrdered((arr), (n), sizeof(T), (COMPARE), (order));           \
+            break;                                                             \
+        }                                                                      \
+        T* sorted = IN_BUFFERS((arr), (n), (order), (T*)scratch.ptr);          \
+        if (sorted != (arr)) memcpy((arr), sorted, (n) * sizeof(T));           \
+        scratchRelease(&scratch);                                              \
+    } while (0)
+
+void radixSortU64(uint64_t arr[], size_t n) {
+    radixSortU64Ordered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortU64Ordered(uint64_t arr[], size_t n, SortOrder order) {
+    RUN_WIDE_RADIX(radixSortU64InBuffers, uint64_t, compareU64, arr, n, order);
+}
+
+void radixSortI64(int64_t arr[], size_t n) {
+    radixSortI64Ordered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortI64Ordered(int64_t arr[], size_t n, SortOrder order) {
+    RUN_WIDE_RADIX(radixSortI64InBuffers, int64_t, compareI64, arr, n, order);
+}
+
+void radixSortKey128(SortKey128 arr[], size_t n) {
+    radixSortKey128Ordered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortKey128Ordered(SortKey128 arr[], size_t n, SortOrder order) {
+    RUN_WIDE_RADIX(radixSortKey128InBuffers, SortKey128, compareKey128, arr, n, order);
+}
+
+#ifdef __SIZEOF_INT128__
+#define BYTE_U128(x, b) ((uint8_t)((x) >> (8 * (b))))
+#define BYTE_I128(x, b) \
+    ((uint8_t)(((unsigned __int128)(x) ^ ((unsigned __int128)1 << 127)) >> (8 * (b))))
+
+DEFINE_LSD_RADIX_SORT(radixSortU128InBuffers, unsigned __int128, 16, BYTE_U128)
+DEFINE_LSD_RADIX_SORT(radixSortI128InBuffers, __int128, 16, BYTE_I128)
+
+static int compareU128(const void* a, const void* b) {
+    unsigned __int128 x = *(const unsigned __int128*)a, y = *(const unsigned __int128*)b;
+    return (x > y) - (x < y);
+}
+
+static int compareI128(const void* a, const void* b) {
+    __int128 x = *(const __int128*)a, y = *(const __int128*)b;
+    return (x > y) - (x < y);
+}
+
+void radixSortU128(unsigned __int128 arr[], size_t n) {
+    radixSortU128Ordered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortU128Ordered(unsigned __int128 arr[], size_t n, SortOrder order) {
+    RUN_WIDE_RADIX(radixSortU128InBuffers, unsigned __int128, compareU128, arr, n, order);
+}
+
+void radixSortI128(__int128 arr[], size_t n) {
+    radixSortI128Ordered(arr, n, SORT_ASCENDING);
+}
+
+void radixSortI128Ordered(__int128 arr[], size_t n, SortOrder order) {
+    RUN_WIDE_RADIX(radixSortI128InBuffers, __int128, compareI128, arr, n, order);
+}
+#endif
+
+
+// --- Indirect (Pointer-Array) Sort ---
+/*
+ * Sorting pointers to heap objects is bound by DRAM latency: every comparison
+ * dereferences two pointees. Each pointer is paired with a cached key prefix
+ * so most comparisons never touch the object, and the partition and merge
+ * loops prefetch pointees INDIRECT_PREFETCH_DISTANCE iterations ahead.
+ */
+typedef struct {
+    uint64_t prefix;
+    void* ptr;
+} IndirectEntry;
+
+static int compareIndirect(const IndirectEntry* a, const IndirectEntry* b, SortCompareFn compare) {
+    if (a->prefix != b->prefix) return a->prefix < b->prefix ? -1 : 1;
+    return compare(a->ptr, b->ptr);
+}
+
+static void insertionSortIndirect(IndirectEntry e[], int left, int right, SortCompareFn compare) {
+    for (int i = left + 1; i <= right; i++) {
+        IndirectEntry key = e[i];
+        int j = i - 1;
+        while (j >= left && compareIndirect(&key, &e[j], compare) < 0) {
+            e[j + 1] = e[j];
+            j--;
+        }
+        e[j + 1] = key;
+    }
+}
+
+static void swapIndirect(IndirectEntry* a, IndirectEntry* b) {
+    IndirectEntry t = *a;
+    *a = *b;
+    *b = t;
+}
+
+// Three-way partition around a median-of-three pivot: on return [low, *lt)
+// precedes the pivot, [*lt, *gt] equals it and (*gt, high] follows it, so
+// runs of equal objects are finished in one pass.
+static void partitionIndirect(IndirectEntry e[], int low, int high, SortCompareFn compare, int* lt, int* gt) {
+    int mid = low + (high - low) / 2;
+    if (compareIndirect(&e[mid], &e[low], compare) < 0) swapIndirect(&e[mid], &e[low]);
+    if (compareIndirect(&e[high], &e[low], compare) < 0) swapIndirect(&e[high], &e[low]);
+    if (compareIndirect(&e[mid], &e[high], compare) < 0) swapIndirect(&e[mid], &e[high]);
+
+    IndirectEntry pivot = e[high];
+    int l = low, i = low, g = high;
+    while (i <= g) {
+        // Only entries whose prefix ties with the pivot will be dereferenced.
+        int ahead = i + INDIRECT_PREFETCH_DISTANCE;
+        if (ahead <= g && e[ahead].prefix == pivot.prefix) PREFETCH(e[ahead].ptr);
+        int c = compareIndirect(&e[i], &pivot, compare);
+        if (c < 0) swapIndirect(&e[l++], &e[i++]);
+        else if (c > 0) swapIndirect(&e[i], &e[g--]);
+        else i++;
+    }
+    *lt = l;
+    *gt = g;
+}
+
+static void heapSiftDownIndirect(IndirectEntry e[], int root, int n, SortCompareFn compare) {
+    IndirectEntry key = e[root];
+    for (int child = 2 * root + 1; child < n; child = 2 * root + 1) {
+        if (child + 1 < n && compareIndirect(&e[child], &e[child + 1], compare) < 0) child++;
+        if (compareIndirect(&key, &e[child], compare) >= 0) break;
+        e[root] = e[child];
+        root = child;
+    }
+    e[root] = key;
+}
+
+static void heapSortIndirect(IndirectEntry e[], int n, SortCompareFn compare) {
+    for (int i = n / 2 - 1; i >= 0; i--) heapSiftDownIndirect(e, i, n, compare);
+    for (int end = n - 1; end > 0; end--) {
+        swapIndirect(&e[0], &e[end]);
+        heapSiftDownIndirect(e, 0, end, compare);
+    }
+}
+
+// Introsort: after depth_left levels of partitioning a range is heap sorted,
+// bounding the worst case at O(n log n) comparisons.
+static void quickSortIndirect(IndirectEntry e[], int low, int high, SortCompareFn compare, int depth_left) {
+    while (high - low + 1 >= INSERTION_SORT_THRESHOLD) {
+        if (depth_left-- == 0) {
+            heapSortIndirect(e + low, high - low + 1, compare);
+            return;
+        }
+        int lt, gt;
+        partitionIndirect(e, low, high, compare, &lt, &gt);
+        // Recurse into the smaller side to bound the stack depth.
+        if (lt - low < high - gt) {
+            quickSortIndirect(e, low, lt - 1, compare, depth_left);
+            low = gt + 1;
+        } else {
+            quickSortIndirect(e, gt + 1, high, compare, depth_left);
+            high = lt - 1;
+        }
+    }
+    insertionSortIndirect(e, low, high, compare);
+}
+
+// Stable bottom-up merge sort; ping-pongs between e and tmp.
+static void mergeSortIndirect(IndirectEntry e[], IndirectEntry tmp[], int n, SortCompareFn compare) {
+    for (int lo = 0; lo < n; lo += INSERTION_SORT_THRESHOLD) {
+        int hi = lo + INSERTION_SORT_THRESHOLD < n ? lo + INSERTION_SORT_THRESHOLD : n;
+        insertionSortIndirect(e, lo, hi - 1, compare);
+    }
+
+    IndirectEntry* src = e;
+    IndirectEntry* dst = tmp;
+    for (int width = INSERTION_SORT_THRESHOLD; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = lo + width < n ? lo + width : n;
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                if (i + INDIRECT_PREFETCH_DISTANCE < mid) PREFETCH(src[i + INDIRECT_PREFETCH_DISTANCE].ptr);
+                if (j + INDIRECT_PREFETCH_DISTANCE < hi) PREFETCH(src[j + INDIRECT_PREFETCH_DISTANCE].ptr);
+                if (compareIndirect(&src[j], &src[i], compare) < 0) dst[k++] = src[j++];
+                else dst[k++] = src[i++];
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+        IndirectEntry* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != e) memcpy(e, src, n * sizeof(IndirectEntry));
+}
+
+/**
+ * @brief Sorts an array of pointers by the objects they point to.
+ * @param ptrs The pointer array to sort (reordered in place).
+ * @param n The number of pointers.
+ * @param compare Compares two pointees.
+ * @param prefix Optional key-prefix extractor; NULL disables prefix caching.
+ * @param stable If true, objects comparing equal keep their relative order.
+ * @return false if the entry buffer could not be allocated (ptrs is untouched).
+ */
+bool indirectSort(void* ptrs[], int n, SortCompareFn compare, SortKeyPrefixFn prefix, bool stable) {
+    if (n <= 1) return true;
+
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, (stable ? 2 : 1) * (size_t)n * sizeof(IndirectEntry), false, &scratch)) {
+        return false;
+    }
+    IndirectEntry* entries = (IndirectEntry*)scratch.ptr;
+    IndirectEntry* tmp = stable ? entries + n : NULL;
+
+    for (int i = 0; i < n; i++) {
+        if (prefix && i + INDIRECT_PREFETCH_DISTANCE < n) PREFETCH(ptrs[i + INDIRECT_PREFETCH_DISTANCE]);
+        entries[i].prefix = prefix ? prefix(ptrs[i]) : 0;
+        entries[i].ptr = ptrs[i];
+    }
+
+    if (stable) {
+        mergeSortIndirect(entries, tmp, n, compare);
+    } else {
+        int depth = 0;
+        for (int m = n; m > 1; m >>= 1) depth += 2; // 2 log2(n)
+        quickSortIndirect(entries, 0, n - 1, compare, depth);
+    }
+
+    for (int i = 0; i < n; i++) ptrs[i] = entries[i].ptr;
+    scratchRelease(&scratch);
+    return true;
+}
+
+
+// =============================================================================
+// 7. MULTI-COLUMN SORT ON NORMALIZED KEYS
+// =============================================================================
+
+/*
+ * Every row is encoded into a normalized key whose plain byte order (memcmp)
+ * equals the requested ORDER BY order, so rows are sorted without calling
+ * back into per-column comparators. Per column the key holds:
+ *   - a null marker byte (0x00/0x01, swapped for NULLS LAST), only for
+ *     columns that have an is_null array,
+ *   - INT:    8 bytes big-endian with the sign bit flipped,
+ *   - FLOAT:  8 bytes big-endian of the IEEE bits, sign-adjusted,
+ *   - STRING: the bytes followed by a 0x00 terminator.
+ * Descending columns invert their value bytes. Null values keep the column
+ * width (zero-filled) for fixed-width types, so all-numeric keys have a
+ * constant length and can be sorted by the radix engines: keys of up to 16
+ * bytes (two non-null numeric columns) are packed into 128 bits, longer ones
+ * are radix sorted byte-wise in the key buffer when few of their bytes vary.
+ */
+
+#define NORMALIZED_KEY_RADIX_BYTES 16 // Fixed-width keys up to this size use radix
+#define NORMALIZED_KEY_LSD_MAX_PASSES 16 // Longer fixed-width keys: radix if this few bytes vary
+
+typedef struct {
+    uint64_t prefix; // First 8 key bytes, big-endian, for cheap comparisons
+    size_t offset;
+    size_t length;
+    int row;
+} NormalizedKeyRef;
+
+typedef struct {
+    SortKey128 key;
+    int row;
+} NormalizedRowKey128;
+
+#define BYTE_ROW_KEY128(x, b) BYTE_KEY128((x).key, b)
+static DEFINE_LSD_RADIX_SORT(radixSortRowKey128InBuffers, NormalizedRowKey128, 16, BYTE_ROW_KEY128)
+
+static size_t columnValueWidth(const SortColumn* col, int row) {
+    switch (col->type) {
+        case SORT_COLUMN_INT:
+        case SORT_COLUMN_FLOAT:
+            return 8;
+        case SORT_COLUMN_STRING:
+        default:
+            if (col->is_null && col->is_null[row]) return 0;
+            return strlen(((const char* const*)col->values)[row]) + 1;
+    }
+}
+
+static void storeBigEndian64(uint8_t* out, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+static uint64_t orderedDoubleBits(double d) {
+    uint64_t bits;
+    if (d == 0.0) d = 0.0;               // -0.0 and 0.0 compare equal
+    if (isnan(d)) d = NAN;               // One canonical NaN, sorted last
+    memcpy(&bits, &d, sizeof(bits));
+    return (bits & UINT64_C(0x8000000000000000)) ? ~bits : bits ^ UINT64_C(0x8000000000000000);
+}
+
+// Encodes one row and returns the number of key bytes written.
+static size_t encodeRowKey(const SortColumn columns[], int num_columns, int row, uint8_t* out) {
+    size_t pos = 0;
+    for (int c = 0; c < num_columns; c++) {
+        const SortColumn* col = &columns[c];
+        bool is_null = col->is_null && col->is_null[row];
+        if (col->is_null) out[pos++] = (uint8_t)(is_null == col->nulls_first ? 0x00 : 0x01);
+
+        size_t start = pos;
+        if (col->type == SORT_COLUMN_STRING) {
+            if (is_null) continue;
+            const char* str = ((const char* const*)col->values)[row];
+            size_t len = strlen(str) + 1; // Include the terminator
+            memcpy(out + pos, str, len);
+            pos += len;
+        } else {
+            uint64_t bits = 0;
+            if (!is_null && col->type == SORT_COLUMN_INT) {
+                bits = (uint64_t)((const int64_t*)col->values)[row] ^ UINT64_C(0x8000000000000000);
+            } else if (!is_null) {
+                bits = orderedDoubleBits(((const double*)col->values)[row]);
+            }
+            storeBigEndian64(out + pos, bits);
+            pos += 8;
+        }
+        if (col->descending && !is_null) {
+            for (size_t i = start; i < pos; i++) out[i] = (uint8_t)~out[i];
+        }
+    }
+    return pos;
+}
+
+static int compareNormalizedKeys(const NormalizedKeyRef* a, const NormalizedKeyRef* b,
+                                 const uint8_t* keys) {
+    if (a->prefix != b->prefix) return a->prefix < b->prefix ? -1 : 1;
+    size_t common = a->length < b->length ? a->length : b->length;
+    if (common > 8) {
+        int c = memcmp(keys + a->offset + 8, keys + b->offset + 8, common - 8);
+        if (c != 0) return c;
+    }
+    return (a->length > b->length) - (a->length < b->length);
+}
+
+// Stable LSD radix sort of row numbers by fixed-width keys stored row after
+// row, skipping the key bytes that are the same in every row. counts needs
+// width * RADIX_BUCKETS entries. Returns false, leaving perm unsorted, if
+// more than NORMALIZED_KEY_LSD_MAX_PASSES bytes vary.
+static bool radixSortFixedKeys(const uint8_t* keys, size_t width, int num_rows, int perm[], int tmp[],
+                               uint32_t counts[]) {
+    memset(counts, 0, width * RADIX_BUCKETS * sizeof(uint32_t));
+    for (int r = 0; r < num_rows; r++) {
+        const uint8_t* key = keys + (size_t)r * width;
+        for (size_t b = 0; b < width; b++) counts[b * RADIX_BUCKETS + key[b]]++;
+    }
+    int passes = 0;
+    for (size_t b = 0; b < width; b++) {
+        if (counts[b * RADIX_BUCKETS + keys[b]] != (uint32_t)num_rows) passes++;
+    }
+    if (passes > NORMALIZED_KEY_LSD_MAX_PASSES) return false;
+
+    for (int r = 0; r < num_rows; r++) perm[r] = r;
+    int* src = perm;
+    int* dst = tmp;
+    for (size_t b = width; b-- > 0;) {
+        uint32_t* count = counts + b * RADIX_BUCKETS;
+        if (count[keys[b]] == (uint32_t)num_rows) continue; // Constant byte
+        uint32_t sum = 0;
+        for (int d = 0; d < RADIX_BUCKETS; d++) {
+            uint32_t c = count[d];
+            count[d] = sum;
+            sum += c;
+        }
+        for (int i = 0; i < num_rows; i++) dst[count[keys[(size_t)src[i] * width + b]]++] = src[i];
+        int* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != perm) memcpy(perm, src, (size_t)num_rows * sizeof(int));
+    return true;
+}
+
+// Stable bottom-up merge sort over key references.
+static void mergeSortNormalizedKeys(NormalizedKeyRef* refs, NormalizedKeyRef* tmp, size_t n,
+                                    const uint8_t* keys) {
+    for (size_t lo = 0; lo < n; lo += INSERTION_SORT_THRESHOLD) {
+        size_t hi = lo + INSERTION_SORT_THRESHOLD < n ? lo + INSERTION_SORT_THRESHOLD : n;
+        for (size_t i = lo + 1; i < hi; i++) {
+            NormalizedKeyRef key = refs[i];
+            size_t j = i;
+            while (j > lo && compareNormalizedKeys(&refs[j - 1], &key, keys) > 0) {
+                refs[j] = refs[j - 1];
+                j--;
+            }
+            refs[j] = key;
+        }
+    }
+
+    NormalizedKeyRef* src = refs;
+    NormalizedKeyRef* dst = tmp;
+    for (size_t width = INSERTION_SORT_THRESHOLD; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                if (compareNormalizedKeys(&src[j], &src[i], keys) < 0) dst[k++] = src[j++];
+                else dst[k++] = src[i++];
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+        NormalizedKeyRef* t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != refs) memcpy(refs, src, n * sizeof(NormalizedKeyRef));
+}
+
+/**
+ * @brief Sorts rows lexicographically by several typed columns.
+ * @param columns The ORDER BY columns, most significant first.
+ * @param num_columns The number of columns.
+ * @param num_rows The number of rows in every column.
+ * @param perm Output: perm[i] is the row that belongs at position i.
+ * @return false if the key buffers could not be allocated (perm is untouched).
+ *
+ * The sort is stable: rows with equal keys keep their original order.
+ */
+bool multiColumnSort(const SortColumn columns[], int num_columns, int num_rows, int perm[]) {
+    if (num_rows <= 0) return true;
+
+    size_t total = 0;
+    bool fixed_width = true;
+    for (int c = 0; c < num_columns; c++) {
+        if (columns[c].type == SORT_COLUMN_STRING) fixed_width = false;
+    }
+    for (int c = 0; c < num_columns; c++) {
+        if (columns[c].is_null) total += (size_t)num_rows; // Null markers
+    }
+    for (int r = 0; r < num_rows; r++) {
+        for (int c = 0; c < num_columns; c++) total += columnValueWidth(&columns[c], r);
+    }
+
+    size_t row_width = total / num_rows;
+    if (fixed_width && row_width <= NORMALIZED_KEY_RADIX_BYTES) {
+        // Short constant-length keys: pack into 128 bits and radix sort. The
+        // permutation is read from whichever half holds the result.
+        ScratchBlock scratch;
+        if (!scratchAcquire(NULL, 2 * (size_t)num_rows * sizeof(NormalizedRowKey128), false, &scratch)) {
+            return false;
+        }
+        NormalizedRowKey128* rows = (NormalizedRowKey128*)scratch.ptr;
+        for (int r = 0; r < num_rows; r++) {
+            uint8_t buf[NORMALIZED_KEY_RADIX_BYTES] = {0};
+            encodeRowKey(columns, num_columns, r, buf);
+            uint64_t hi = 0, lo = 0;
+            for (int i = 0; i < 8; i++) hi = (hi << 8) | buf[i];
+            for (int i = 8; i < 16; i++) lo = (lo << 8) | buf[i];
+            rows[r].key.hi = hi;
+            rows[r].key.lo = lo;
+            rows[r].row = r;
+        }
+        NormalizedRowKey128* sorted =
+            radixSortRowKey128InBuffers(rows, (size_t)num_rows, SORT_ASCENDING, rows + num_rows);
+        for (int r = 0; r < num_rows; r++) perm[r] = sorted[r].row;
+        scratchRelease(&scratch);
+        return true;
+    }
+
+    // Longer keys are encoded row after row; fixed-width ones try the
+    // byte-wise radix sort (whose counters follow the keys) before the merge.
+    size_t counts_bytes = fixed_width ? row_width * RADIX_BUCKETS * sizeof(uint32_t) : 0;
+    size_t keys_bytes = (total + 8 + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    ScratchBlock scratch;
+    if (!scratchAcquire(NULL, 2 * (size_t)num_rows * sizeof(NormalizedKeyRef) + keys_bytes + counts_bytes,
+                        false, &scratch)) {
+        return false;
+    }
+    NormalizedKeyRef* refs = (NormalizedKeyRef*)scratch.ptr;
+    NormalizedKeyRef* tmp = refs + num_rows;
+    uint8_t* keys = (uint8_t*)(tmp + num_rows);
+
+    if (fixed_width) {
+        for (int r = 0; r < num_rows; r++) encodeRowKey(columns, num_columns, r, keys + (size_t)r * row_width);
+        if (radixSortFixedKeys(keys, row_width, num_rows, perm, (int*)refs,
+                               (uint32_t*)(keys + keys_bytes))) {
+            scratchRelease(&scratch);
+            return true;
+        }
+    }
+
+    size_t offset = 0;
+    for (int r = 0; r < num_rows; r++) {
+        size_t len = fixed_width ? row_width : encodeRowKey(columns, num_columns, r, keys + offset);
+        uint8_t head[8] = {0};
+        memcpy(head, keys + offset, len < 8 ? len : 8);
+        uint64_t prefix = 0;
+        for (int i = 0; i < 8; i++) prefix = (prefix << 8) | head[i];
+        refs[r].prefix = prefix;
+        refs[r].offset = offset;
+        refs[r].length = len;
+        refs[r].row = r;
+        offset += len;
+    }
+
+    mergeSortNormalizedKeys(refs, tmp, (size_t)num_rows, keys);
+    for (int r = 0; r < num_rows; r++) perm[r] = refs[r].row;
+
+    scratchRelease(&scratch);
+    return true;
+}
+
+
+// =============================================================================
+// 8. UTILITY AND HELPER FUNCTIONS
+// =============================================================================
+
+void printArray(const char* label, const int arr[], int n) {
+    printf("%s: [", label);
+    for (int i = 0; i < n; ++i) {
+        printf("%d", arr[i]);
+        if (i < n - 1) printf(", ");
+    }
+    printf("]\n");
+}
+
+void swap(int* a, int* b) {
+    int t = *a;
+    *a = *b;
+    *b = t;
+}
+
+void reverseElements(void* base, size_t n, size_t size) {
+    unsigned char* lo = (unsigned char*)base;
+    unsigned char* hi = lo + (n ? n - 1 : 0) * size;
+    while (lo < hi) {
+        for (size_t b = 0; b < size; b++) {
+            unsigned char t = lo[b];
+            lo[b] = hi[b];
+            hi[b] = t;
+        }
+        lo += size;
+        hi -= size;
+    }
+}
+
+int compareInts(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y); // Subtraction would overflow for distant values
+}
+
+int compareU64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int compareI64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+int compareKey128(const void* a, const void* b) {
+    const SortKey128* x = (const SortKey128*)a;
+    const SortKey128* y = (const SortKey128*)b;
+    if (x->hi != y->hi) return (x->hi > y->hi) - (x->hi < y->hi);
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+
+// =============================================================================
+// 9. DEMONSTRATION IN MAIN
+// =============================================================================
+
+// --- Benchmarks ---
+#if defined(__linux__)
+// Opens a per-thread dTLB miss counter for loads or stores; -1 if unavailable.
+static int openTlbMissCounter(unsigned long long op) {
+    struct perf_event_attr pe;
+    memset(&pe, 0, sizeof(pe));
+    pe.type = PERF_TYPE_HW_CACHE;
+    pe.size = sizeof(pe);
+    pe.config = PERF_COUNT_HW_CACHE_DTLB | (op << 8) | ((unsigned long long)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    pe.disabled = 1;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+}
+
+static long long readCounter(int fd) {
+    long long value = -1;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return value;
+}
+#endif
+
+static double elapsedSeconds(struct timespec start, struct timespec end) {
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * Sorts the same large random array with normal and with huge-page scratch
+ * and reports wall time and dTLB load/store misses (via perf_event_open; shown
+ * as n/a where the counters are not available).
+ */
+static void benchmarkHugePages(int n) {
+    int* original = (int*)malloc((size_t)n * sizeof(int));
+    int* work = (int*)malloc((size_t)n * sizeof(int));
+    if (!original || !work) {
+        printf("Benchmark: could not allocate %d elements\n", n);
+        free(original);
+        free(work);
+        return;
+    }
+    for (int i = 0; i < n; i++) original[i] = rand();
+
+    printf("--- Huge-Page Scratch Benchmark (n = %d) ---\n", n);
+    for (int huge = 0; huge <= 1; huge++) {
+        memcpy(work, original, (size_t)n * sizeof(int));
+        SortOptions options = {0};
+        options.use_huge_pages = huge;
+
+        long long load_misses = -1, store_misses = -1;
+        struct timespec start, end;
+#if defined(__linux__)
+        int load_fd = openTlbMissCounter(PERF_COUNT_HW_CACHE_OP_READ);
+        int store_fd = openTlbMissCounter(PERF_COUNT_HW_CACHE_OP_WRITE);
+        if (load_fd >= 0) ioctl(load_fd, PERF_EVENT_IOC_ENABLE, 0);
+        if (store_fd >= 0) ioctl(store_fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        adaptiveHybridSortWithOptions(work, n, &options);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+#if defined(__linux__)
+        load_misses = readCounter(load_fd);
+        store_misses = readCounter(store_fd);
+        if (load_fd >= 0) close(load_fd);
+        if (store_fd >= 0) close(store_fd);
+#endif
+
+        printf("%-12s %8.3f s   dTLB load misses: ", huge ? "huge pages" : "4KB pages", elapsedSeconds(start, end));
+        if (load_misses >= 0) printf("%lld", load_misses); else printf("n/a");
+        printf("   dTLB store misses: ");
+        if (store_misses >= 0) printf("%lld\n", store_misses); else printf("n/a\n");
+    }
+
+    free(original);
+    free(work);
+}
+
+// Completion callback for the demo: shows which engine ran and why.
+static void printDecision(const SortCallInfo* info, void* context) {
+    (void)context;
+    printf(" -> Strategy: %s (%s)\n", strategyName(info->used), sortReasonName(info->reason));
+}
+
+int main(int argc, char* argv[]) {
+    srand(time(NULL));
+
+    if (argc > 1 && strcmp(argv[1], "--bench-hugepages") == 0) {
+        benchmarkHugePages(argc > 2 ? atoi(argv[2]) : (1 << 26));
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--calibrate") == 0) {
+        const char* path = argc > 2 ? argv[2] : "polysort.tuning";
+        printf("Calibrating sorting engines on this host...\n");
+        if (!sortCalibrate(path)) {
+            printf("Calibration failed: could not allocate memory or write %s\n", path);
+            return 1;
+        }
+        printf("Small-array cutoff: %d\n", smallSortCutoff());
+        for (int s = 0; s < STRATEGY_COUNT; s++) {
+            SortCostCoefficients c;
+            sortCostGetCoefficients((SortStrategy)s, &c);
+            printf("  %-14s per_unit %8.3f ns\n", strategyName((SortStrategy)s), c.per_unit);
+        }
+        printf("Wrote %s; set %s=%s to use it.\n", path, SORT_TUNING_ENV, path);
+        return 0;
+    }
+
+    printf("--- Adaptive Hybrid Sort Demonstration ---\n\n");
+    sortSetCompletionCallback(printDecision, NULL);
+
+    // Case 1: Nearly sorted data
+    int nearly_sorted[] = {1, 2, 3, 10, 5, 6, 7, 8, 9, 4, 11, 12};
+    int n1 = sizeof(nearly_sorted) / sizeof(nearly_sorted[0]);
+    printArray("Case 1 (Nearly Sorted) - Before", nearly_sorted, n1);
+    adaptiveHybridSort(nearly_sorted, n1);
+    printArray("Case 1 (Nearly Sorted) - After ", nearly_sorted, n1);
+    printf("\n--------------------------------------------\n\n");
+
+    // Case 2: Non-negative integers
+    int positive_ints[] = {170, 45, 75, 90, 802, 24, 2, 66};
+    int n2 = sizeof(positive_ints) / sizeof(positive_ints[0]);
+    printArray("Case 2 (Positive Integers) - Before", positive_ints, n2);
+    adaptiveHybridSort(positive_ints, n2);
+    printArray("Case 2 (Positive Integers) - After ", positive_ints, n2);
+    printf("\n--------------------------------------------\n\n");
+
+    // Case 3: Random data with negatives
+    int random_data[] = {9, -3, 5, 2, 6, 8, -6, 1, 3, 4, 15, 0, -10};
+    int n3 = sizeof(random_data) / sizeof(random_data[0]);
+    printArray("Case 3 (Random w/ Negatives) - Before", random_data, n3);
+    adaptiveHybridSort(random_data, n3);
+    printArray("Case 3 (Random w/ Negatives) - After ", random_data, n3);
+    printf("\n--------------------------------------------\n\n");
+
+    // Case 4: Small array (will use Insertion Sort)
+    int small_array[] = {5, 1, 4, 2, 8};
+    int n4 = sizeof(small_array) / sizeof(small_array[0]);
+    printArray("Case 4 (Small Array) - Before", small_array, n4);
+    adaptiveHybridSort(small_array, n4);
+    printArray("Case 4 (Small Array) - After ", small_array, n4);
+    printf("\n--------------------------------------------\n\n");
+
+    // Case 5: Descending order, handled natively by the chosen engine
+    int scores[] = {42, 7, 19, 88, 3, 56, 71, 23, 64, 11, 95, 38, 5, 81, 29, 60,
+                    14, 77, 33, 50, 9, 68, 45, 2, 91, 26, 73, 17, 84, 36, 59, 12};
+    int n_scores = sizeof(scores) / sizeof(scores[0]);
+    printArray("Case 5 (Descending) - Before", scores, n_scores);
+    SortOptions descending = {0};
+    descending.order = SORT_DESCENDING;
+    SortExplanation explanation;
+    sortExplain(scores, n_scores, &descending, &explanation);
+    printf(" Explain: %s (%s); predicted ns:", strategyName(explanation.strategy),
+           sortReasonName(explanation.reason));
+    for (int s = 0; s < STRATEGY_COUNT; s++) {
+        if (explanation.predicted_ns[s] < HUGE_VAL) {
+            printf(" %s %.0f", strategyName((SortStrategy)s), explanation.predicted_ns[s]);
+        }
+    }
+    printf("\n");
+    adaptiveHybridSortOrdered(scores, n_scores, SORT_DESCENDING);
+    printArray("Case 5 (Descending) - After ", scores, n_scores);
+    printf("\n--------------------------------------------\n\n");
+
+    // Case 6: 64-bit timestamps (wide-key radix, only the low bytes vary)
+    int64_t timestamps[] = {1700000000123LL, 1700000000007LL, 1699999999999LL,
+                            1700000000456LL, 1700000000001LL, 1700000000090LL};
+    int n6 = sizeof(timestamps) / sizeof(timestamps[0]);
+    radixSortI64(timestamps, n6);
+    printf("Case 6 (64-bit Timestamps) - After : [");
+    for (int i = 0; i < n6; ++i) {
+        printf("%lld%s", (long long)timestamps[i], i < n6 - 1 ? ", " : "]\n");
+    }
     printf("\n");
 
     return 0;